@@ -0,0 +1,144 @@
+#include "ChannelRouting.h"
+#include <algorithm>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CHANNELROUTING_NEON 1
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define CHANNELROUTING_SSE 1
+#endif
+
+static unsigned int spanLength(unsigned int first, unsigned int hvChannels, unsigned int inUse, unsigned int available)
+{
+	if(hvChannels <= first)
+		return 0;
+	return std::min(std::min(hvChannels - first, inUse), available);
+}
+
+void ChannelRouting::setup(const BelaContext* context, unsigned int hvInputChannels, unsigned int hvOutputChannels,
+		unsigned int audioChannelsInUse, unsigned int analogChannelsInUse)
+{
+	audioFramesPerAnalogFrame = context->analogFrames ? context->audioFrames / context->analogFrames : 0;
+	inputSpans.clear();
+	outputSpans.clear();
+
+	unsigned int n;
+	if((n = spanLength(0, hvInputChannels, audioChannelsInUse, context->audioInChannels)))
+		inputSpans.push_back({ kAudio, 0, 0, n });
+	if((n = spanLength(0, hvOutputChannels, audioChannelsInUse, context->audioOutChannels)))
+		outputSpans.push_back({ kAudio, 0, 0, n });
+	if(audioFramesPerAnalogFrame) {
+		if((n = spanLength(audioChannelsInUse, hvInputChannels, analogChannelsInUse, context->analogInChannels)))
+			inputSpans.push_back({ kAnalog, audioChannelsInUse, 0, n });
+		if((n = spanLength(audioChannelsInUse, hvOutputChannels, analogChannelsInUse, context->analogOutChannels)))
+			outputSpans.push_back({ kAnalog, audioChannelsInUse, 0, n });
+	}
+}
+
+static void deinterleaveStereo(const float* src, float* left, float* right, unsigned int frames)
+{
+	unsigned int n = 0;
+#if CHANNELROUTING_NEON
+	for(; n + 4 <= frames; n += 4) {
+		float32x4x2_t v = vld2q_f32(src + 2 * n);
+		vst1q_f32(left + n, v.val[0]);
+		vst1q_f32(right + n, v.val[1]);
+	}
+#elif CHANNELROUTING_SSE
+	for(; n + 4 <= frames; n += 4) {
+		__m128 a = _mm_loadu_ps(src + 2 * n); // LRLR
+		__m128 b = _mm_loadu_ps(src + 2 * n + 4); // LRLR
+		_mm_storeu_ps(left + n, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(right + n, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+#endif
+	for(; n < frames; ++n) {
+		left[n] = src[2 * n];
+		right[n] = src[2 * n + 1];
+	}
+}
+
+static void interleaveStereo(float* dst, const float* left, const float* right, const float* gain, unsigned int frames)
+{
+	unsigned int n = 0;
+#if CHANNELROUTING_NEON
+	for(; n + 4 <= frames; n += 4) {
+		float32x4x2_t v;
+		float32x4_t g = vld1q_f32(gain + n);
+		v.val[0] = vmulq_f32(vld1q_f32(left + n), g);
+		v.val[1] = vmulq_f32(vld1q_f32(right + n), g);
+		vst2q_f32(dst + 2 * n, v);
+	}
+#elif CHANNELROUTING_SSE
+	for(; n + 4 <= frames; n += 4) {
+		__m128 g = _mm_loadu_ps(gain + n);
+		__m128 l = _mm_mul_ps(_mm_loadu_ps(left + n), g);
+		__m128 r = _mm_mul_ps(_mm_loadu_ps(right + n), g);
+		_mm_storeu_ps(dst + 2 * n, _mm_unpacklo_ps(l, r));
+		_mm_storeu_ps(dst + 2 * n + 4, _mm_unpackhi_ps(l, r));
+	}
+#endif
+	for(; n < frames; ++n) {
+		dst[2 * n] = left[n] * gain[n];
+		dst[2 * n + 1] = right[n] * gain[n];
+	}
+}
+
+void ChannelRouting::deinterleave(const BelaContext* context, float* hvInputBuffers) const
+{
+	const unsigned int frames = context->audioFrames;
+	for(const Span& span : inputSpans) {
+		float* hv = hvInputBuffers + span.hvChannel * frames;
+		if(span.type == kAudio) {
+			const unsigned int stride = context->audioInChannels;
+			if(span.numChannels == 2 && stride == 2) {
+				deinterleaveStereo(context->audioIn, hv, hv + frames, frames);
+				continue;
+			}
+			for(unsigned int c = 0; c < span.numChannels; ++c, hv += frames) {
+				const float* src = context->audioIn + span.belaChannel + c;
+				for(unsigned int n = 0; n < frames; ++n)
+					hv[n] = src[n * stride];
+			}
+		} else {
+			// hold each analog sample for audioFramesPerAnalogFrame frames
+			const unsigned int stride = context->analogInChannels;
+			const unsigned int hold = audioFramesPerAnalogFrame;
+			for(unsigned int c = 0; c < span.numChannels; ++c, hv += frames) {
+				const float* src = context->analogIn + span.belaChannel + c;
+				for(unsigned int m = 0; m < context->analogFrames; ++m)
+					std::fill_n(hv + m * hold, hold, src[m * stride]);
+			}
+		}
+	}
+}
+
+void ChannelRouting::interleave(BelaContext* context, const float* hvOutputBuffers, const float* audioGain) const
+{
+	const unsigned int frames = context->audioFrames;
+	for(const Span& span : outputSpans) {
+		const float* hv = hvOutputBuffers + span.hvChannel * frames;
+		if(span.type == kAudio) {
+			const unsigned int stride = context->audioOutChannels;
+			if(span.numChannels == 2 && stride == 2) {
+				interleaveStereo(context->audioOut, hv, hv + frames, audioGain, frames);
+				continue;
+			}
+			for(unsigned int c = 0; c < span.numChannels; ++c, hv += frames) {
+				float* dst = context->audioOut + span.belaChannel + c;
+				for(unsigned int n = 0; n < frames; ++n)
+					dst[n * stride] = hv[n] * audioGain[n];
+			}
+		} else {
+			// keep the last audio frame of each analog frame
+			const unsigned int stride = context->analogOutChannels;
+			const unsigned int hold = audioFramesPerAnalogFrame;
+			for(unsigned int c = 0; c < span.numChannels; ++c, hv += frames) {
+				float* dst = context->analogOut + span.belaChannel + c;
+				for(unsigned int m = 0; m < context->analogFrames; ++m)
+					dst[m * stride] = hv[m * hold + hold - 1];
+			}
+		}
+	}
+}
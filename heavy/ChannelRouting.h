@@ -0,0 +1,55 @@
+/*
+ * ChannelRouting
+ * --------------
+ * Moves samples between the interleaved Bela buffers and Heavy's planar
+ * buffers. Which Heavy channel maps to which audio or analog channel is
+ * worked out once in setup() into a list of spans, each a run of consecutive
+ * channels of one kind, so the per-block work is straight copies with no
+ * per-sample tests.
+ *
+ * Heavy channels 0 to audioChannelsInUse - 1 are the audio channels, the
+ * following analogChannelsInUse are the analog ones. Analog inputs are held
+ * for audioFramesPerAnalogFrame audio frames, analog outputs take the last
+ * audio frame of each analog frame. Heavy channels past the analog ones are
+ * left to the caller (digital and scope channels).
+ *
+ * A stereo audio span, the common case, uses NEON or SSE to (de)interleave
+ * four frames at a time.
+ */
+
+#ifndef CHANNELROUTING_H_
+#define CHANNELROUTING_H_
+
+#include <Bela.h>
+#include <vector>
+
+class ChannelRouting {
+public:
+	void setup(const BelaContext* context, unsigned int hvInputChannels, unsigned int hvOutputChannels,
+			unsigned int audioChannelsInUse, unsigned int analogChannelsInUse);
+
+	// Bela inputs to Heavy's planar input buffers
+	void deinterleave(const BelaContext* context, float* hvInputBuffers) const;
+	// Heavy's planar output buffers to the Bela outputs, audio frame n scaled
+	// by audioGain[n]
+	void interleave(BelaContext* context, const float* hvOutputBuffers, const float* audioGain) const;
+
+private:
+	enum SpanType {
+		kAudio,
+		kAnalog,
+	};
+
+	struct Span {
+		SpanType type;
+		unsigned int hvChannel; // first Heavy channel
+		unsigned int belaChannel; // first audio or analog channel
+		unsigned int numChannels;
+	};
+
+	std::vector<Span> inputSpans;
+	std::vector<Span> outputSpans;
+	unsigned int audioFramesPerAnalogFrame;
+};
+
+#endif // CHANNELROUTING_H_
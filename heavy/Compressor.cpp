@@ -0,0 +1,140 @@
+#include "Compressor.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define COMPRESSOR_NEON 1
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define COMPRESSOR_SSE 1
+#endif
+
+float Compressor::window[kWindowSize];
+
+bool Compressor::fillWindow()
+{
+	// as sEnv_init, in float
+	float total = 0;
+	for(unsigned int n = 0; n < kWindowSize; ++n) {
+		window[n] = 0.5f * (1.f - cosf((float)(2.0 * M_PI * n) / (float)(kWindowSize - 1)));
+		total += window[n];
+	}
+	for(unsigned int n = 0; n < kWindowSize; ++n)
+		window[n] /= total;
+	return true;
+}
+
+// Scales numFrames samples by a gain that starts at gain and moves by step
+// every sample, and returns the sum of their squares weighted by w
+static float applyGain(const float* in, float* out, const float* w, unsigned int numFrames, float gain, float step)
+{
+	float sum = 0;
+	unsigned int n = 0;
+#if COMPRESSOR_NEON
+	float32x4_t acc = vdupq_n_f32(0.f);
+	float32x4_t g = (float32x4_t) { gain, gain + step, gain + 2 * step, gain + 3 * step };
+	const float32x4_t dg = vdupq_n_f32(4 * step);
+	for(; n + 4 <= numFrames; n += 4) {
+		const float32x4_t x = vld1q_f32(in + n);
+		acc = vmlaq_f32(acc, vld1q_f32(w + n), vmulq_f32(x, x));
+		vst1q_f32(out + n, vmulq_f32(x, g));
+		g = vaddq_f32(g, dg);
+	}
+	sum = vgetq_lane_f32(acc, 0) + vgetq_lane_f32(acc, 1) + vgetq_lane_f32(acc, 2) + vgetq_lane_f32(acc, 3);
+#elif COMPRESSOR_SSE
+	__m128 acc = _mm_setzero_ps();
+	__m128 g = _mm_setr_ps(gain, gain + step, gain + 2 * step, gain + 3 * step);
+	const __m128 dg = _mm_set1_ps(4 * step);
+	for(; n + 4 <= numFrames; n += 4) {
+		const __m128 x = _mm_loadu_ps(in + n);
+		acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(w + n), _mm_mul_ps(x, x)));
+		_mm_storeu_ps(out + n, _mm_mul_ps(x, g));
+		g = _mm_add_ps(g, dg);
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, acc);
+	sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+	for(; n < numFrames; ++n) {
+		const float x = in[n];
+		sum += w[n] * x * x;
+		out[n] = x * (gain + n * step);
+	}
+	return sum;
+}
+
+Compressor::Compressor() :
+	threshold(70),
+	ratio(1)
+{
+	setup(44100);
+}
+
+void Compressor::setup(float newSampleRate)
+{
+	// once, even with compressors set up on several threads
+	static const bool filled = fillWindow();
+	(void)filled;
+	sampleRate = newSampleRate;
+	reset();
+}
+
+void Compressor::reset()
+{
+	sum = 0;
+	position = 0;
+	level = 0;
+	reduction = 0;
+	gain = 0;
+	target = 0;
+	step = 0;
+	rampFrames = 0;
+}
+
+void Compressor::setThreshold(float dB)
+{
+	threshold = dB;
+}
+
+void Compressor::setRatio(float newRatio)
+{
+	ratio = newRatio;
+}
+
+void Compressor::process(const float* in, float* out, unsigned int numFrames)
+{
+	while(numFrames) {
+		const unsigned int frames = std::min(numFrames, kWindowSize - position);
+		const unsigned int ramp = std::min(frames, rampFrames);
+		sum += applyGain(in, out, window + position, ramp, gain, step);
+		rampFrames -= ramp;
+		gain = rampFrames ? gain + ramp * step : target;
+		sum += applyGain(in + ramp, out + ramp, window + position + ramp, frames - ramp, gain, 0);
+
+		position += frames;
+		if(position == kWindowSize)
+			endWindow();
+		in += frames;
+		out += frames;
+		numFrames -= frames;
+	}
+}
+
+void Compressor::endWindow()
+{
+	// env~: 100 dB for an RMS of 1, never below 0
+	level = std::max(4.342944819f * logf(sum) + 100.f, 0.f);
+	sum = 0;
+	position = 0;
+
+	const float newReduction = level >= threshold ? powf(10.f, ((level - threshold) / ratio + threshold - level) / 20.f) : 1.f;
+	const float ms = newReduction > reduction ? kReleaseMs : kAttackMs;
+	reduction = newReduction;
+	target = std::min(newReduction, 1.f);
+	rampFrames = (unsigned int)(ms * sampleRate / 1000.0);
+	if(rampFrames)
+		step = (target - gain) / rampFrames;
+	else
+		gain = target;
+}
@@ -0,0 +1,65 @@
+/*
+ * Compressor
+ * ----------
+ * [hv.compressor~] as one kernel: the envelope follower, the gain computer
+ * and the gain ramp in a single pass over the block.
+ *
+ * The abstraction measures the input with [env~ 256], which Heavy runs by
+ * storing the squared input and, every 256 samples, summing it against a
+ * Hann window. Above the threshold the level is brought down by the ratio,
+ * and the gain that gives is sent to [line~] over 5 ms when it falls and
+ * 105 ms when it rises; below it the gain goes back to 1. The windows here
+ * do not overlap, so the weighted sum is accumulated as the samples come in
+ * and nothing is stored. The gain changes on the sample after a window
+ * completes, as the message from [env~] reaches [line~] in Heavy.
+ *
+ * Levels are on env~'s scale, where 100 dB is an RMS of 1, so the
+ * thresholds from kompparam carry over. Like the abstraction, the output
+ * starts silent and rises to full gain after the first window.
+ */
+
+#ifndef COMPRESSOR_H_
+#define COMPRESSOR_H_
+
+class Compressor {
+public:
+	static constexpr unsigned int kWindowSize = 256;
+	static constexpr float kAttackMs = 5;
+	static constexpr float kReleaseMs = 105;
+
+	Compressor();
+
+	void setup(float sampleRate);
+	void reset();
+
+	void setThreshold(float dB);
+	void setRatio(float ratio);
+
+	// in and out may be the same buffer
+	void process(const float* in, float* out, unsigned int numFrames);
+
+	float getLevel() const { return level; } // of the last full window, in dB
+	float getGain() const { return gain; }
+
+private:
+	static float window[kWindowSize]; // Hann, normalised to sum to 1 as env~'s
+	static bool fillWindow();
+
+	void endWindow();
+
+	float sampleRate;
+	float threshold;
+	float ratio;
+
+	float sum; // of the weighted squares so far in this window
+	unsigned int position; // in the window
+	float level;
+	float reduction; // last computed, before it is limited to 1
+
+	float gain; // for the next sample
+	float target;
+	float step;
+	unsigned int rampFrames; // left before gain reaches target
+};
+
+#endif // COMPRESSOR_H_
@@ -0,0 +1,85 @@
+#include "ControlQueue.h"
+#include <Heavy_bela.h>
+#include <stdlib.h>
+#include <string.h>
+
+ControlQueue::~ControlQueue()
+{
+	free(message);
+}
+
+void ControlQueue::setup(unsigned int capacity)
+{
+	unsigned int size = 1;
+	while(size < capacity)
+		size <<= 1;
+	slots.assign(size, Message());
+	mask = size - 1;
+	free(message);
+	message = (HvMessage*) malloc(hv_msg_getByteSize(kMaxFloats));
+	head.store(0);
+	tail.store(0);
+	pushed.store(0);
+	dropped.store(0);
+	delivered.store(0);
+	rejected.store(0);
+	deferred.store(0);
+}
+
+bool ControlQueue::push(uint32_t receiverHash, const float* values, unsigned int numFloats)
+{
+	const uint32_t h = head.load(std::memory_order_relaxed);
+	if(slots.empty() || numFloats > kMaxFloats || h - tail.load(std::memory_order_acquire) > mask) {
+		dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return false;
+	}
+	Message& m = slots[h & mask];
+	m.receiverHash = receiverHash;
+	m.numFloats = numFloats;
+	if(numFloats)
+		memcpy(m.values, values, numFloats * sizeof(float));
+	head.store(h + 1, std::memory_order_release);
+	pushed.store(pushed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	return true;
+}
+
+unsigned int ControlQueue::drain(HeavyContextInterface* context, unsigned int maxMessages)
+{
+	uint32_t t = tail.load(std::memory_order_relaxed);
+	const uint32_t h = head.load(std::memory_order_acquire);
+	if(t == h)
+		return 0;
+	unsigned int n = 0;
+	unsigned int numRejected = 0;
+	for(; t != h && n < maxMessages; ++t, ++n) {
+		const Message& m = slots[t & mask];
+		if(m.numFloats) {
+			hv_msg_init(message, m.numFloats, 0);
+			for(unsigned int i = 0; i < m.numFloats; ++i)
+				hv_msg_setFloat(message, i, m.values[i]);
+		} else {
+			hv_msg_init(message, 1, 0);
+			hv_msg_setBang(message, 0);
+		}
+		if(!hv_sendMessageToReceiver(context, m.receiverHash, 0, message))
+			++numRejected;
+	}
+	tail.store(t, std::memory_order_release);
+	delivered.store(delivered.load(std::memory_order_relaxed) + n - numRejected, std::memory_order_relaxed);
+	if(numRejected)
+		rejected.store(rejected.load(std::memory_order_relaxed) + numRejected, std::memory_order_relaxed);
+	if(t != h)
+		deferred.store(deferred.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	return n;
+}
+
+ControlQueue::Stats ControlQueue::getStats() const
+{
+	Stats s;
+	s.pushed = pushed.load(std::memory_order_relaxed);
+	s.dropped = dropped.load(std::memory_order_relaxed);
+	s.delivered = delivered.load(std::memory_order_relaxed);
+	s.rejected = rejected.load(std::memory_order_relaxed);
+	s.deferred = deferred.load(std::memory_order_relaxed);
+	return s;
+}
@@ -0,0 +1,87 @@
+/*
+ * ControlQueue
+ * ------------
+ * Carries control messages from one auxiliary task (OSC, a file watcher, a
+ * UI) to the audio thread, which passes them on to Heavy.
+ *
+ * Heavy's own hv_send*() functions are not meant to be called from another
+ * thread while render() runs: they take a spinlock that render() also
+ * takes, and read the block timestamp without synchronisation. Instead the
+ * task push()es into this ring, and render() drain()s it before
+ * hv_processInline(), so the messages are due at the start of that block.
+ *
+ * The ring is single producer, single consumer: every slot is allocated in
+ * setup(), push() and drain() only move two atomic indices, and neither
+ * side ever waits for the other. Give each producing task its own queue.
+ * A full ring drops the message and counts it, and so does drain() when
+ * Heavy's input queue has no room for it. drain() delivers at most
+ * maxMessages per block and leaves the rest for the next one, so a burst
+ * cannot take the block over.
+ */
+
+#ifndef CONTROLQUEUE_H_
+#define CONTROLQUEUE_H_
+
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+class HeavyContextInterface;
+struct HvMessage;
+
+class ControlQueue {
+public:
+	enum { kMaxFloats = 4 };
+
+	struct Stats {
+		uint64_t pushed;
+		uint64_t dropped; // the ring was full
+		uint64_t delivered;
+		uint64_t rejected; // Heavy's input queue was full
+		uint64_t deferred; // blocks that hit the drain budget
+	};
+
+	ControlQueue() {}
+	~ControlQueue();
+
+	// capacity is rounded up to a power of two
+	void setup(unsigned int capacity);
+
+	// Producer. numFloats 0 sends a bang. Returns false if the message was
+	// dropped.
+	bool push(uint32_t receiverHash, const float* values, unsigned int numFloats);
+	bool pushFloat(uint32_t receiverHash, float value) { return push(receiverHash, &value, 1); }
+	bool pushBang(uint32_t receiverHash) { return push(receiverHash, nullptr, 0); }
+
+	// Consumer, on the audio thread. Returns how many messages were taken
+	// off the ring, rejected ones included.
+	unsigned int drain(HeavyContextInterface* context, unsigned int maxMessages);
+
+	Stats getStats() const;
+
+private:
+	ControlQueue(const ControlQueue&);
+	ControlQueue& operator=(const ControlQueue&);
+
+	struct Message {
+		uint32_t receiverHash;
+		uint32_t numFloats;
+		float values[kMaxFloats];
+	};
+
+	std::vector<Message> slots;
+	uint32_t mask = 0;
+	HvMessage* message = nullptr; // built here for Heavy to copy
+
+	// written by the producer
+	alignas(64) std::atomic<uint32_t> head { 0 };
+	std::atomic<uint64_t> pushed { 0 };
+	std::atomic<uint64_t> dropped { 0 };
+	// written by the consumer
+	alignas(64) std::atomic<uint32_t> tail { 0 };
+	std::atomic<uint64_t> delivered { 0 };
+	std::atomic<uint64_t> rejected { 0 };
+	std::atomic<uint64_t> deferred { 0 };
+};
+
+#endif // CONTROLQUEUE_H_
@@ -0,0 +1,55 @@
+#include "DeadlineWatchdog.h"
+#include <algorithm>
+
+void DeadlineWatchdog::setup(unsigned int numLevels, uint32_t budgetNs, unsigned int degradeBlocks,
+		unsigned int recoverBlocks, unsigned int warmupBlocks, float highLoad, float lowLoad)
+{
+	this->numLevels = std::max(1u, std::min(numLevels, (unsigned int)kMaxLevels));
+	this->budgetNs = budgetNs;
+	smoothing = 1.f / std::max(1u, degradeBlocks);
+	holdBlocks = degradeBlocks;
+	this->recoverBlocks = std::max(1u, recoverBlocks);
+	this->highLoad = highLoad;
+	this->lowLoad = std::min(lowLoad, highLoad);
+	warmup = warmupBlocks;
+	level = 0;
+	load = 0;
+	held = 0;
+	calm = 0;
+	stats = {};
+}
+
+void DeadlineWatchdog::changeLevel(unsigned int newLevel, float blockLoad)
+{
+	level = newLevel;
+	// a single spike does not count twice
+	load = std::min(blockLoad, highLoad);
+	held = 0;
+	calm = 0;
+}
+
+void DeadlineWatchdog::endBlock()
+{
+	const uint32_t blockNs = now() - blockStart;
+	if(warmup) {
+		--warmup;
+		return;
+	}
+	const float blockLoad = blockNs / budgetNs;
+	++stats.blocks[level];
+	stats.worstNs = std::max(stats.worstNs, blockNs);
+	const bool overrun = blockLoad >= 1;
+	stats.overruns += overrun;
+
+	load += (std::min(blockLoad, (float)kMaxBlockLoad) - load) * smoothing;
+	calm = load < lowLoad ? calm + 1 : 0;
+	if(held < holdBlocks)
+		++held;
+
+	if(level + 1 < numLevels && load > highLoad && held >= holdBlocks) {
+		++stats.degrades;
+		changeLevel(level + 1, blockLoad);
+	} else if(level > 0 && calm >= recoverBlocks && held >= holdBlocks) {
+		changeLevel(level - 1, blockLoad);
+	}
+}
@@ -0,0 +1,79 @@
+/*
+ * DeadlineWatchdog
+ * ----------------
+ * Times render() against the block deadline and picks a quality level, so
+ * that under sustained load the caller gives up something audible but
+ * harmless before the block overruns.
+ *
+ * Level 0 is full quality, every level above it sheds more. render() calls
+ * beginBlock() first and endBlock() last, and does what getLevel() asks in
+ * between. The first warmupBlocks are not timed at all. The load of a
+ * block is its time over the budget, at most kMaxBlockLoad, averaged over
+ * about degradeBlocks, so a single overrun cannot take the average over
+ * highLoad on its own. Once the average goes over highLoad the level goes
+ * up by one. It comes back down by one only once the average has stayed
+ * under lowLoad for recoverBlocks, and the gap between the two thresholds
+ * keeps it from flapping. After every change the average starts again from
+ * the block that caused it, capped at highLoad, and the level holds for
+ * degradeBlocks so the change has time to show in the timings.
+ */
+
+#ifndef DEADLINEWATCHDOG_H_
+#define DEADLINEWATCHDOG_H_
+
+#include <stdint.h>
+#include <time.h>
+
+class DeadlineWatchdog {
+public:
+	enum {
+		kMaxLevels = 8,
+		kMaxBlockLoad = 2, // what an overrun adds to the average at most
+	};
+
+	struct Stats {
+		uint64_t blocks[kMaxLevels]; // spent at each level
+		uint64_t overruns; // blocks over the budget, after the warm-up
+		uint64_t degrades;
+		uint32_t worstNs;
+	};
+
+	void setup(unsigned int numLevels, uint32_t budgetNs, unsigned int degradeBlocks,
+			unsigned int recoverBlocks, unsigned int warmupBlocks, float highLoad = 0.75f, float lowLoad = 0.4f);
+
+	void beginBlock() { blockStart = now(); }
+	void endBlock();
+
+	unsigned int getLevel() const { return level; }
+	float getLoad() const { return load; }
+	const Stats& getStats() const { return stats; }
+
+private:
+	static uint64_t now()
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+	}
+
+	void changeLevel(unsigned int newLevel, float blockLoad);
+
+	unsigned int numLevels = 1;
+	float budgetNs = 0;
+	float smoothing = 1; // weight of each block in the average
+	unsigned int holdBlocks = 0;
+	unsigned int recoverBlocks = 0;
+	float highLoad = 0;
+	float lowLoad = 0;
+
+	// audio thread
+	uint64_t blockStart = 0;
+	unsigned int warmup = 0; // blocks still to ignore
+	unsigned int level = 0;
+	float load = 0;
+	unsigned int held = 0; // blocks since the last change
+	unsigned int calm = 0; // blocks since the average went under lowLoad
+	Stats stats = {};
+};
+
+#endif // DEADLINEWATCHDOG_H_
@@ -0,0 +1,164 @@
+#include "EventLog.h"
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+
+using namespace EventLog;
+
+static const char kMagic[4] = { 'T', 'Y', 'E', 'V' };
+
+EventRecorder::~EventRecorder()
+{
+	if(file)
+		fclose(file);
+}
+
+bool EventRecorder::open(const char* path, float sampleRate, unsigned int capacity)
+{
+	file = fopen(path, "wb");
+	if(!file) {
+		fprintf(stderr, "Error: cannot write %s: %s\n", path, strerror(errno));
+		return false;
+	}
+	this->sampleRate = sampleRate;
+	writeHeader(0);
+
+	unsigned int size = 1;
+	while(size < capacity)
+		size <<= 1;
+	ring.assign(size, Event());
+	mask = size - 1;
+	recorded = 0;
+	dropped = 0;
+	head.store(0);
+	tail.store(0);
+	return true;
+}
+
+void EventRecorder::writeHeader(uint64_t lengthFrames)
+{
+	Header header = {};
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.sampleRate = sampleRate;
+	header.lengthFrames = lengthFrames;
+	fwrite(&header, sizeof(header), 1, file);
+}
+
+void EventRecorder::record(Type type, unsigned int index, float value, uint64_t frame)
+{
+	if(!file)
+		return;
+	const uint32_t h = head.load(std::memory_order_relaxed);
+	if(h - tail.load(std::memory_order_acquire) > mask) {
+		++dropped;
+		return;
+	}
+	Event& e = ring[h & mask];
+	e.frame = frame;
+	e.type = type;
+	e.index = index;
+	e.reserved = 0;
+	e.value = value;
+	head.store(h + 1, std::memory_order_release);
+	++recorded;
+}
+
+bool EventRecorder::wantsFlush() const
+{
+	return file && head.load(std::memory_order_relaxed) - tail.load(std::memory_order_relaxed) > (mask + 1) / 4;
+}
+
+void EventRecorder::flush()
+{
+	std::lock_guard<std::mutex> lock(fileMutex);
+	writeRing();
+}
+
+void EventRecorder::writeRing()
+{
+	if(!file)
+		return;
+	uint32_t t = tail.load(std::memory_order_relaxed);
+	const uint32_t h = head.load(std::memory_order_acquire);
+	while(t != h) {
+		// up to the end of the ring, then from its start
+		const uint32_t start = t & mask;
+		const uint32_t count = std::min<uint32_t>(h - t, mask + 1 - start);
+		fwrite(&ring[start], sizeof(Event), count, file);
+		t += count;
+		tail.store(t, std::memory_order_release);
+	}
+	fflush(file);
+}
+
+void EventRecorder::close(uint64_t lengthFrames)
+{
+	std::lock_guard<std::mutex> lock(fileMutex);
+	if(!file)
+		return;
+	writeRing();
+	fseek(file, 0, SEEK_SET);
+	writeHeader(lengthFrames);
+	fclose(file);
+	file = nullptr;
+}
+
+bool EventReplayer::load(const char* path, float sampleRate)
+{
+	events.clear();
+	FILE* f = fopen(path, "rb");
+	if(!f) {
+		fprintf(stderr, "Error: cannot open %s: %s\n", path, strerror(errno));
+		return false;
+	}
+	Header header;
+	const char* error = nullptr;
+	if(fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, kMagic, sizeof(kMagic)))
+		error = "not an event recording";
+	else if(header.version != kVersion)
+		error = "unsupported version";
+	else if(header.sampleRate != sampleRate)
+		error = "recorded at another sample rate";
+	Event e;
+	while(!error && fread(&e, sizeof(e), 1, f) == 1) {
+		if(e.type > kHit || (!events.empty() && e.frame < events.back().frame))
+			error = "bad event";
+		events.push_back(e);
+	}
+	fclose(f);
+	if(!error && events.empty())
+		error = "no events";
+	if(error) {
+		fprintf(stderr, "Error: %s: %s\n", path, error);
+		events.clear();
+		return false;
+	}
+	// a recording that was not closed ends with its last event
+	lengthFrames = std::max(header.lengthFrames, events.back().frame + 1);
+	started = false;
+	position = 0;
+	return true;
+}
+
+const Event* EventReplayer::next(uint64_t blockStartFrame, uint64_t endFrame)
+{
+	if(events.empty())
+		return nullptr;
+	if(!started) {
+		started = true;
+		offset = blockStartFrame;
+		position = 0;
+	}
+	if(position == events.size()) {
+		if(endFrame <= offset + lengthFrames)
+			return nullptr;
+		offset += lengthFrames;
+		position = 0;
+	}
+	if(events[position].frame + offset >= endFrame)
+		return nullptr;
+	current = events[position++];
+	current.frame += offset;
+	return &current;
+}
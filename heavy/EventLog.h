@@ -0,0 +1,121 @@
+/*
+ * EventLog
+ * --------
+ * Records the key, X-key and hit events render() dispatches to the patch,
+ * and plays a recording back in place of the sensors, so that a real
+ * performance can be rerun as a benchmark or a null test between builds.
+ *
+ * A recording is a Header followed by Events, little endian. Event frames
+ * count audio frames from the start of the audio, as audioFramesElapsed
+ * does, so played back at the same block size every event lands on the
+ * same frame of the same block.
+ *
+ * EventRecorder keeps the events in a ring allocated in open(). record() is
+ * called on the audio thread and only writes into the ring; flush() writes
+ * the ring to the file and is meant for an auxiliary task. A full ring drops
+ * events and counts them. close() flushes what is left and writes the
+ * length into the header.
+ *
+ * EventReplayer loads a whole recording in load() and hands the events
+ * out block by block, starting over at the end of the recording.
+ */
+
+#ifndef EVENTLOG_H_
+#define EVENTLOG_H_
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+namespace EventLog {
+
+enum Type : uint8_t {
+	kKey, // index, value 1 for pressed and 0 for released
+	kXKey, // same
+	kHit, // value is the velocity
+};
+
+struct Header {
+	char magic[4]; // "TYEV"
+	uint32_t version;
+	float sampleRate;
+	uint32_t reserved;
+	uint64_t lengthFrames; // 0 if the recording was not closed
+};
+
+struct Event {
+	uint64_t frame;
+	uint8_t type;
+	uint8_t index;
+	uint16_t reserved;
+	float value;
+};
+
+enum { kVersion = 1 };
+
+} // namespace EventLog
+
+class EventRecorder {
+public:
+	EventRecorder() {}
+	~EventRecorder();
+
+	bool open(const char* path, float sampleRate, unsigned int capacity = 4096);
+	bool isOpen() const { return file != nullptr; }
+
+	// Audio thread
+	void record(EventLog::Type type, unsigned int index, float value, uint64_t frame);
+	// Audio thread. True once the ring is a quarter full.
+	bool wantsFlush() const;
+
+	// Auxiliary task
+	void flush();
+	// After the audio has stopped. lengthFrames is how long the audio ran.
+	void close(uint64_t lengthFrames);
+
+	uint64_t getRecorded() const { return recorded; }
+	uint64_t getDropped() const { return dropped; }
+
+private:
+	EventRecorder(const EventRecorder&);
+	EventRecorder& operator=(const EventRecorder&);
+
+	void writeHeader(uint64_t lengthFrames);
+	void writeRing();
+
+	FILE* file = nullptr;
+	std::mutex fileMutex; // between flush() and close(), never on the audio thread
+	float sampleRate = 0;
+	std::vector<EventLog::Event> ring;
+	uint32_t mask = 0;
+	uint64_t recorded = 0;
+	uint64_t dropped = 0;
+	std::atomic<uint32_t> head { 0 }; // written by record()
+	std::atomic<uint32_t> tail { 0 }; // written by flush()
+};
+
+class EventReplayer {
+public:
+	bool load(const char* path, float sampleRate);
+	bool isLoaded() const { return !events.empty(); }
+
+	// Audio thread. Returns the next event due before endFrame, with its
+	// frame moved to the time it is due, or null when there are no more in
+	// this block. Playback starts at the blockStartFrame of the first call.
+	const EventLog::Event* next(uint64_t blockStartFrame, uint64_t endFrame);
+
+	uint64_t getLengthFrames() const { return lengthFrames; }
+	size_t getNumEvents() const { return events.size(); }
+
+private:
+	std::vector<EventLog::Event> events;
+	uint64_t lengthFrames = 0;
+	bool started = false;
+	uint64_t offset = 0; // added to the recorded frames
+	size_t position = 0;
+	EventLog::Event current;
+};
+
+#endif // EVENTLOG_H_
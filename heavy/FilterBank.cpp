@@ -0,0 +1,132 @@
+#include "FilterBank.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FILTERBANK_NEON 1
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define FILTERBANK_SSE 1
+#endif
+
+FilterBank::Coefficients FilterBank::resonator(float sampleRate, float freq, float q, float gain)
+{
+	const double w = 2 * M_PI * freq / sampleRate;
+	const double r = exp(-w / q);
+	return { gain, 0.f, (float)(-gain * r), (float)(-2 * r * cos(w)), (float)(r * r) };
+}
+
+FilterBank::Coefficients FilterBank::peak(float sampleRate, float freq, float q, float gain)
+{
+	// as peakparams, which passes a1 and b1 to rootsa and rootsb halved
+	const double a = sqrt(gain);
+	const double cosw = cos(2 * M_PI * freq / sampleRate);
+	const double alpha = sqrt(1 - cosw * cosw) / (2 * q);
+	const double a0 = 1 + alpha / a;
+	const double g = (1 + alpha * a) / a0;
+	const double a1 = cosw / a0;
+	const double a2 = (1 - alpha / a) / a0;
+	const double b1 = a1 / (1 + alpha * a);
+	const double b2 = (1 - alpha * a) / a0 / (1 + alpha * a);
+	// rootsa only solves for complex poles, real ones come out with this
+	// product instead of a2
+	const double poleProduct = a1 * a1 + fabs(a1 * a1 - a2);
+	return { (float)g, (float)(-2 * b1 * g), (float)(b2 * g), (float)(-2 * a1), (float)poleProduct };
+}
+
+FilterBank::FilterBank() :
+	numLanes(0),
+	stride(0)
+{
+}
+
+void FilterBank::setup(unsigned int newNumLanes)
+{
+	numLanes = newNumLanes;
+	stride = (numLanes + kLanesPerGroup - 1) / kLanesPerGroup * kLanesPerGroup;
+	data.assign(kNumArrays * stride, 0.f);
+}
+
+void FilterBank::reset()
+{
+	std::fill_n(array(kS1), stride, 0.f);
+	std::fill_n(array(kS2), stride, 0.f);
+}
+
+void FilterBank::setCoefficients(unsigned int lane, const Coefficients& c)
+{
+	if(lane >= numLanes)
+		return;
+	array(kB0)[lane] = c.b0;
+	array(kB1)[lane] = c.b1;
+	array(kB2)[lane] = c.b2;
+	array(kA1)[lane] = c.a1;
+	array(kA2)[lane] = c.a2;
+}
+
+FilterBank::Coefficients FilterBank::getCoefficients(unsigned int lane) const
+{
+	return { array(kB0)[lane], array(kB1)[lane], array(kB2)[lane], array(kA1)[lane], array(kA2)[lane] };
+}
+
+// transposed direct form II, one lane group over the whole block
+void FilterBank::process(const float* in, float* out, unsigned int numFrames)
+{
+	for(unsigned int l = 0; l < stride; l += kLanesPerGroup) {
+		float* s1 = array(kS1) + l;
+		float* s2 = array(kS2) + l;
+#if FILTERBANK_NEON
+		const float32x4_t b0 = vld1q_f32(array(kB0) + l);
+		const float32x4_t b1 = vld1q_f32(array(kB1) + l);
+		const float32x4_t b2 = vld1q_f32(array(kB2) + l);
+		const float32x4_t a1 = vld1q_f32(array(kA1) + l);
+		const float32x4_t a2 = vld1q_f32(array(kA2) + l);
+		float32x4_t z1 = vld1q_f32(s1);
+		float32x4_t z2 = vld1q_f32(s2);
+		for(unsigned int n = 0; n < numFrames; ++n) {
+			const float32x4_t x = vld1q_f32(in + n * stride + l);
+			const float32x4_t y = vmlaq_f32(z1, b0, x);
+			z1 = vmlsq_f32(vmlaq_f32(z2, b1, x), a1, y);
+			z2 = vmlsq_f32(vmulq_f32(b2, x), a2, y);
+			vst1q_f32(out + n * stride + l, y);
+		}
+		vst1q_f32(s1, z1);
+		vst1q_f32(s2, z2);
+#elif FILTERBANK_SSE
+		const __m128 b0 = _mm_loadu_ps(array(kB0) + l);
+		const __m128 b1 = _mm_loadu_ps(array(kB1) + l);
+		const __m128 b2 = _mm_loadu_ps(array(kB2) + l);
+		const __m128 a1 = _mm_loadu_ps(array(kA1) + l);
+		const __m128 a2 = _mm_loadu_ps(array(kA2) + l);
+		__m128 z1 = _mm_loadu_ps(s1);
+		__m128 z2 = _mm_loadu_ps(s2);
+		for(unsigned int n = 0; n < numFrames; ++n) {
+			const __m128 x = _mm_loadu_ps(in + n * stride + l);
+			const __m128 y = _mm_add_ps(z1, _mm_mul_ps(b0, x));
+			z1 = _mm_sub_ps(_mm_add_ps(z2, _mm_mul_ps(b1, x)), _mm_mul_ps(a1, y));
+			z2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+			_mm_storeu_ps(out + n * stride + l, y);
+		}
+		_mm_storeu_ps(s1, z1);
+		_mm_storeu_ps(s2, z2);
+#else
+		for(unsigned int k = 0; k < kLanesPerGroup; ++k) {
+			const unsigned int lane = l + k;
+			const float b0 = array(kB0)[lane], b1 = array(kB1)[lane], b2 = array(kB2)[lane];
+			const float a1 = array(kA1)[lane], a2 = array(kA2)[lane];
+			float z1 = s1[k];
+			float z2 = s2[k];
+			for(unsigned int n = 0; n < numFrames; ++n) {
+				const float x = in[n * stride + lane];
+				const float y = z1 + b0 * x;
+				z1 = z2 + b1 * x - a1 * y;
+				z2 = b2 * x - a2 * y;
+				out[n * stride + lane] = y;
+			}
+			s1[k] = z1;
+			s2[k] = z2;
+		}
+#endif
+	}
+}
@@ -0,0 +1,70 @@
+/*
+ * FilterBank
+ * ----------
+ * A bank of independent biquads kept as structure of arrays, one lane per
+ * filter, processed four lanes at a time with NEON or SSE.
+ *
+ * Each section of filters~ is a pair of complex poles followed by a pair of
+ * zeros: [cpole~ cpole~ rzero~ rzero~] in resonfilters.pd and [cpole~ cpole~
+ * czero~ czero~] in peakfilters.pd, with the coefficients worked out per
+ * sample by resonparams and peakparams. The poles and the zeros come in
+ * conjugate pairs, so each section is one real biquad, and resonator() and
+ * peak() give its coefficients from the same inputs as the subpatches:
+ *
+ *   reson  H(z) = gain (1 - r z^-2) / (1 - 2 r cos(w) z^-1 + r^2 z^-2)
+ *          with w = 2 pi freq / sr and r = exp(-w / q)
+ *   peak   the peaking filter of peakparams, with its a1 / b1 scaling kept
+ *          as it is so the bank sounds like the patch
+ *
+ * Lane l of frame n is at n * getStride() + l in the buffers passed to
+ * process(), so a frame of all lanes is one contiguous load. Coefficients
+ * and state stay in registers for the whole block, and every lane group
+ * costs five multiplies and four adds per frame whichever filters it holds.
+ * Lanes past getNumLanes() are padding and pass nothing through.
+ */
+
+#ifndef FILTERBANK_H_
+#define FILTERBANK_H_
+
+#include <vector>
+
+class FilterBank {
+public:
+	static constexpr unsigned int kLanesPerGroup = 4;
+
+	// y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+	struct Coefficients {
+		float b0, b1, b2, a1, a2;
+	};
+
+	static Coefficients resonator(float sampleRate, float freq, float q, float gain);
+	static Coefficients peak(float sampleRate, float freq, float q, float gain);
+
+	FilterBank();
+
+	void setup(unsigned int numLanes);
+	// Clear the state of every lane, the coefficients are kept
+	void reset();
+
+	void setCoefficients(unsigned int lane, const Coefficients& c);
+	Coefficients getCoefficients(unsigned int lane) const;
+
+	// in and out hold numFrames frames of getStride() floats each, and may
+	// be the same buffer
+	void process(const float* in, float* out, unsigned int numFrames);
+
+	unsigned int getNumLanes() const { return numLanes; }
+	unsigned int getStride() const { return stride; }
+
+private:
+	enum { kB0, kB1, kB2, kA1, kA2, kS1, kS2, kNumArrays };
+
+	float* array(unsigned int a) { return &data[a * stride]; }
+	const float* array(unsigned int a) const { return &data[a * stride]; }
+
+	std::vector<float> data; // kNumArrays arrays of stride floats
+	unsigned int numLanes;
+	unsigned int stride;
+};
+
+#endif // FILTERBANK_H_
@@ -0,0 +1,145 @@
+#include "HeavyPools.h"
+#include <HeavyContext.hpp>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+// HeavyContext keeps the pool and the input queue protected. A pointer to
+// a member named through a derived class can be used on any HeavyContext.
+struct Access : public HeavyContext {
+	static HvMessageQueue HeavyContext::* messageQueue() { return &Access::mq; }
+	static HvLightPipe HeavyContext::* inputQueue() { return &Access::inQueue; }
+};
+
+const HvMessagePool& pool(HeavyContextInterface* context)
+{
+	return (static_cast<HeavyContext*>(context)->*Access::messageQueue()).mp;
+}
+
+HvLightPipe& inputQueue(HeavyContextInterface* context)
+{
+	return static_cast<HeavyContext*>(context)->*Access::inputQueue();
+}
+
+int toKb(size_t bytes, unsigned int margin, int minKb)
+{
+	return std::max<int>(minKb, (bytes * margin + 1023) / 1024);
+}
+
+bool pastWarning(size_t bytes, size_t capacity)
+{
+	return bytes * 100 > capacity * HeavyPools::kWarnPercent;
+}
+
+const char* const kPoolName = "poolKb";
+const char* const kInQueueName = "inQueueKb";
+
+} // namespace
+
+HeavyPools::HeavyPools() :
+	context(nullptr),
+	inQueueHighWater(0),
+	sendFailures(0),
+	warned(false)
+{
+}
+
+void HeavyPools::setup(HeavyContextInterface* newContext)
+{
+	context = newContext;
+	inQueueHighWater = 0;
+	sendFailures = 0;
+	warned = false;
+}
+
+bool HeavyPools::sample()
+{
+	if(!context)
+		return false;
+	// the bytes from the read head to the write head, which may have
+	// wrapped around to the start
+	const HvLightPipe& q = inputQueue(context);
+	const size_t waiting = q.writeHead >= q.readHead ? q.writeHead - q.readHead
+		: (q.buffer + q.len - q.readHead) + (q.writeHead - q.buffer);
+	inQueueHighWater = std::max(inQueueHighWater, waiting);
+	if(warned || !isNearlyFull())
+		return false;
+	warned = true;
+	return true;
+}
+
+HeavyPools::Usage HeavyPools::getUsage() const
+{
+	Usage usage = {};
+	if(context) {
+		usage.poolBytes = pool(context).bufferIndex;
+		usage.poolCapacity = pool(context).bufferSize;
+		usage.inQueueBytes = inQueueHighWater;
+		usage.inQueueCapacity = inputQueue(context).len;
+	}
+	usage.sendFailures = sendFailures;
+	return usage;
+}
+
+HeavyPools::Sizes HeavyPools::recommend() const
+{
+	const Usage usage = getUsage();
+	return { toKb(usage.poolBytes, kPoolMargin, kMinPoolKb), toKb(usage.inQueueBytes, kInQueueMargin, kMinInQueueKb) };
+}
+
+bool HeavyPools::isNearlyFull() const
+{
+	if(!context)
+		return false;
+	return pastWarning(pool(context).bufferIndex, pool(context).bufferSize)
+		|| pastWarning(inQueueHighWater, inputQueue(context).len);
+}
+
+bool HeavyPools::load(const char* path, Sizes& sizes)
+{
+	FILE* f = fopen(path, "r");
+	if(!f) {
+		fprintf(stderr, "Error: cannot open %s\n", path);
+		return false;
+	}
+	char name[32];
+	int kb;
+	bool ok = true;
+	while(ok) {
+		const int n = fscanf(f, "%31s %d", name, &kb);
+		if(n == EOF)
+			break;
+		if(n != 2 || kb <= 0) {
+			fprintf(stderr, "Error: %s is not a list of sizes in kB\n", path);
+			ok = false;
+		} else if(!strcmp(name, kPoolName)) {
+			sizes.poolKb = kb;
+		} else if(!strcmp(name, kInQueueName)) {
+			sizes.inQueueKb = kb;
+		}
+	}
+	if(ok && sizes.poolKb < kMinPoolKb) {
+		fprintf(stderr, "Warning: %s gives the message pool %d kB, using %d kB\n", path, sizes.poolKb, kMinPoolKb);
+		sizes.poolKb = kMinPoolKb;
+	}
+	if(ok && sizes.inQueueKb < kMinInQueueKb) {
+		fprintf(stderr, "Warning: %s gives the input queue %d kB, using %d kB\n", path, sizes.inQueueKb,
+				kMinInQueueKb);
+		sizes.inQueueKb = kMinInQueueKb;
+	}
+	fclose(f);
+	return ok;
+}
+
+bool HeavyPools::save(const char* path, const Sizes& sizes)
+{
+	FILE* f = fopen(path, "w");
+	if(!f) {
+		fprintf(stderr, "Error: cannot write %s\n", path);
+		return false;
+	}
+	fprintf(f, "%s %d\n%s %d\n", kPoolName, sizes.poolKb, kInQueueName, sizes.inQueueKb);
+	return fclose(f) == 0;
+}
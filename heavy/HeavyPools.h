@@ -0,0 +1,83 @@
+/*
+ * HeavyPools
+ * ----------
+ * How much of its message pool and input queue Heavy uses, and what to
+ * give it instead of a guess.
+ *
+ * Both are sized once, in hv_bela_new_with_options(). The pool holds every
+ * message waiting in the patch, [delay] and [pipe] included, and reserves
+ * it 512 bytes at a time without ever giving any back, so how far it has
+ * reserved is its high-water mark. The input queue holds what the wrapper
+ * sends between two blocks; sample() measures it just before
+ * hv_processInline(), when it is at its fullest. With asserts off, a full
+ * queue makes hv_sendMessageToReceiver() return false, which the wrapper
+ * counts with sendFailed(), and a full pool writes past its end, so the
+ * pool is the one to give room.
+ *
+ * recommend() is kPoolMargin times the pool's high-water mark and
+ * kInQueueMargin times the input queue's, in whole kB and never below
+ * kMinPoolKb and kMinInQueueKb: a short run does not see every burst the
+ * instrument will. load() and save() keep sizes in a small text file, one
+ * "name kB" pair per line, that setup() reads before creating the context;
+ * load() raises sizes below the minimums to them. sample() returns true the
+ * first time either high-water mark passes kWarnPercent of its capacity,
+ * for the caller to warn about off the audio thread.
+ */
+
+#ifndef HEAVYPOOLS_H_
+#define HEAVYPOOLS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+class HeavyContextInterface;
+
+class HeavyPools {
+public:
+	enum {
+		kPoolMargin = 8,
+		kInQueueMargin = 2,
+		kMinPoolKb = 128,
+		kMinInQueueKb = 16,
+		kWarnPercent = 75,
+	};
+
+	struct Sizes {
+		int poolKb;
+		int inQueueKb;
+	};
+
+	struct Usage {
+		size_t poolBytes; // reserved so far
+		size_t poolCapacity;
+		size_t inQueueBytes; // most ever waiting at the start of a block
+		size_t inQueueCapacity;
+		uint64_t sendFailures;
+	};
+
+	HeavyPools();
+
+	void setup(HeavyContextInterface* context);
+
+	// Audio thread, just before hv_processInline(). Returns true once, when
+	// either high-water mark first passes kWarnPercent of its capacity.
+	bool sample();
+	void sendFailed() { ++sendFailures; }
+
+	Usage getUsage() const;
+	Sizes recommend() const;
+	// Either high-water mark is past kWarnPercent of its capacity
+	bool isNearlyFull() const;
+
+	// Non-real-time. load() leaves sizes alone for a name it does not find.
+	static bool load(const char* path, Sizes& sizes);
+	static bool save(const char* path, const Sizes& sizes);
+
+private:
+	HeavyContextInterface* context;
+	size_t inQueueHighWater;
+	uint64_t sendFailures;
+	bool warned;
+};
+
+#endif // HEAVYPOOLS_H_
@@ -0,0 +1,56 @@
+#include "HitDetector.h"
+#include <algorithm>
+
+HitDetector::HitDetector()
+{
+	setup(22050);
+}
+
+void HitDetector::setup(float sampleRate, const Settings& settings)
+{
+	const float framesPerMs = sampleRate / 1000.f;
+	onsetThreshold = settings.onsetThreshold;
+	releaseThreshold = settings.releaseThreshold;
+	holdoffFrames = settings.holdoffMs * framesPerMs + 0.5f;
+	peakDecay = settings.peakDecayPerMs / framesPerMs;
+	velocityScale = framesPerMs / settings.fullVelocityDropPerMs;
+	reset();
+}
+
+void HitDetector::reset()
+{
+	frame = 0;
+	holdoff = 0;
+	peak = 0;
+	peakFrame = 0;
+}
+
+unsigned int HitDetector::process(const float* samples, unsigned int numFrames, unsigned int stride,
+		Onset* onsets, unsigned int maxOnsets)
+{
+	unsigned int numOnsets = 0;
+	for(unsigned int n = 0; n < numFrames; ++n, ++frame) {
+		const float x = samples[n * stride];
+
+		// the peak follows the input up straight away and decays slowly, so
+		// peakFrame stays where a fast fall started
+		const float decayed = peak - peakDecay;
+		const bool rising = x >= decayed;
+		peak = rising ? x : decayed;
+		peakFrame = rising ? frame : peakFrame;
+
+		holdoff -= (x > releaseThreshold) & (holdoff > 0);
+
+		if(x < onsetThreshold) {
+			if(holdoff == 0 && numOnsets < maxOnsets) {
+				const float drop = peak - x;
+				const float elapsed = (float)(frame - peakFrame + 1);
+				onsets[numOnsets].frame = n;
+				onsets[numOnsets].velocity = std::max(0.f, std::min(1.f, drop * velocityScale / elapsed));
+				++numOnsets;
+			}
+			holdoff = holdoffFrames;
+		}
+	}
+	return numOnsets;
+}
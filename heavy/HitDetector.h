@@ -0,0 +1,64 @@
+/*
+ * HitDetector
+ * -----------
+ * Onset detector for the type bar hit sensor, run over every sample of an
+ * analog channel. The sensor rests high and drops when the bar hits the
+ * platen.
+ *
+ * An onset is reported when the input falls below onsetThreshold, unless the
+ * detector is still holding off from the previous hit: after a hit it has to
+ * read above releaseThreshold for holdoffMs before it is armed again.
+ *
+ * The velocity comes from how fast the input fell: a peak follower keeps the
+ * level and the time the fall started from, and the drop from there to the
+ * onset per millisecond is scaled so that fullVelocityDropPerMs maps to 1.
+ *
+ * The per-sample work is a couple of compares and selects. The only branch
+ * is the onset path itself, which is not taken while the sensor is at rest.
+ */
+
+#ifndef HITDETECTOR_H_
+#define HITDETECTOR_H_
+
+#include <stdint.h>
+
+class HitDetector {
+public:
+	struct Settings {
+		float onsetThreshold = 0.1f;
+		float releaseThreshold = 0.4f;
+		float holdoffMs = 46.44f; // 1024 samples at the 22.05 kHz analog rate
+		float peakDecayPerMs = 0.002f;
+		float fullVelocityDropPerMs = 0.7f;
+	};
+
+	struct Onset {
+		unsigned int frame; // in the analog block
+		float velocity; // 0 to 1
+	};
+
+	HitDetector();
+
+	void setup(float sampleRate, const Settings& settings);
+	void setup(float sampleRate) { setup(sampleRate, Settings()); }
+	void reset();
+
+	// Scan numFrames samples spaced stride floats apart. Writes up to
+	// maxOnsets onsets and returns how many there were.
+	unsigned int process(const float* samples, unsigned int numFrames, unsigned int stride,
+			Onset* onsets, unsigned int maxOnsets);
+
+private:
+	float onsetThreshold;
+	float releaseThreshold;
+	uint32_t holdoffFrames;
+	float peakDecay; // per frame
+	float velocityScale; // frames per unit of drop at full velocity
+
+	uint32_t frame; // running frame count
+	uint32_t holdoff; // frames above releaseThreshold left before re-arming
+	float peak;
+	uint32_t peakFrame;
+};
+
+#endif // HITDETECTOR_H_
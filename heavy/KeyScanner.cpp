@@ -0,0 +1,77 @@
+#include "KeyScanner.h"
+#include <string.h>
+
+KeyScanner::KeyScanner() :
+	validMask(0),
+	debounceBlocks(0)
+{
+	reset();
+}
+
+void KeyScanner::setup(uint64_t newValidMask, unsigned int newDebounceBlocks)
+{
+	validMask = newValidMask;
+	debounceBlocks = newDebounceBlocks;
+	reset();
+}
+
+void KeyScanner::reset()
+{
+	state = 0;
+	releasing = 0;
+	memset(debounce, 0, sizeof(debounce));
+}
+
+void KeyScanner::process(uint64_t input, uint64_t& pressed, uint64_t& released)
+{
+	input &= validMask;
+	uint64_t changed = input ^ state;
+	pressed = changed & input;
+	state |= pressed;
+
+	// keys that read down again stop releasing, the ones that just read up
+	// for the first time start counting down
+	releasing &= ~input;
+	for(uint64_t k = changed & ~input & ~releasing; k; k = clearLowest(k))
+		debounce[lowest(k)] = debounceBlocks;
+	releasing |= changed & ~input;
+
+	released = 0;
+	for(uint64_t k = releasing; k; k = clearLowest(k)) {
+		unsigned int key = lowest(k);
+		if(debounce[key] == 0)
+			released |= 1ull << key;
+		else
+			--debounce[key];
+	}
+	state &= ~released;
+	releasing &= ~released;
+}
+
+uint64_t KeyScanner::packMatrix(const uint32_t* digital, unsigned int numFrames,
+		unsigned int firstRowPin, unsigned int numRows)
+{
+	// Multiplying the (at most 7) row bits by this constant moves row m to
+	// bit 8 * m without any of the partial products overlapping.
+	static const uint64_t kSpread = 0x0002040810204081ull;
+	static const uint64_t kColumn = 0x0101010101010101ull;
+	const uint32_t rowMask = (1u << numRows) - 1;
+	if(numFrames > 8)
+		numFrames = 8;
+	uint64_t keys = 0;
+	for(unsigned int n = 0; n < numFrames; ++n) {
+		uint64_t rows = (~digital[n] >> (16 + firstRowPin)) & rowMask;
+		keys |= ((rows * kSpread) & kColumn) << n;
+	}
+	return keys;
+}
+
+uint32_t KeyScanner::packColumn(const uint32_t* digital, unsigned int numFrames, unsigned int pin)
+{
+	if(numFrames > 32)
+		numFrames = 32;
+	uint32_t levels = 0;
+	for(unsigned int n = 0; n < numFrames; ++n)
+		levels |= ((digital[n] >> (16 + pin)) & 1) << n;
+	return levels;
+}
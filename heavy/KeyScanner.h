@@ -0,0 +1,62 @@
+/*
+ * KeyScanner
+ * ----------
+ * Debounced key state for up to 64 keys, kept as one bit per key.
+ *
+ * Each block the caller packs the raw key inputs into a bitmask (see
+ * packMatrix() and packColumn()). process() XORs it against the debounced
+ * state, reports presses straight away and releases once a key has been up
+ * for debounceBlocks consecutive blocks. Only the keys that differ from
+ * their debounced state are visited, so a block where nothing moves costs a
+ * couple of word operations regardless of the number of keys.
+ */
+
+#ifndef KEYSCANNER_H_
+#define KEYSCANNER_H_
+
+#include <stdint.h>
+
+class KeyScanner {
+public:
+	static constexpr unsigned int kMaxKeys = 64;
+
+	KeyScanner();
+
+	// validMask selects the bits that are real keys, anything else is
+	// ignored. A key has to read up for debounceBlocks blocks in a row
+	// before it is released.
+	void setup(uint64_t validMask, unsigned int debounceBlocks);
+
+	// Feed the current raw input, bit k set when key k reads down. Returns the
+	// keys that went down and up in this block in pressed and released.
+	void process(uint64_t input, uint64_t& pressed, uint64_t& released);
+
+	uint64_t getState() const { return state; }
+	void reset();
+
+	// Pack the key matrix from the Bela digital words: digital frame n
+	// addresses column n, rows are read from numRows consecutive pins
+	// starting at firstRowPin and are active low. Key (m, n) ends up in bit
+	// m * 8 + n.
+	static uint64_t packMatrix(const uint32_t* digital, unsigned int numFrames,
+			unsigned int firstRowPin, unsigned int numRows);
+
+	// Pack one pin over the first numFrames (at most 32) digital frames, so
+	// that bit n is the level of the pin in frame n.
+	static uint32_t packColumn(const uint32_t* digital, unsigned int numFrames, unsigned int pin);
+
+	// Iterate the set bits of a mask, lowest first:
+	// for(uint64_t m = mask; m; m = KeyScanner::clearLowest(m))
+	//     doSomething(KeyScanner::lowest(m));
+	static inline unsigned int lowest(uint64_t mask) { return __builtin_ctzll(mask); }
+	static inline uint64_t clearLowest(uint64_t mask) { return mask & (mask - 1); }
+
+private:
+	uint64_t validMask;
+	uint64_t state; // debounced state, 1 = down
+	uint64_t releasing; // keys that are down in state but read up
+	unsigned int debounceBlocks;
+	uint16_t debounce[kMaxKeys]; // remaining blocks, only valid for keys in releasing
+};
+
+#endif // KEYSCANNER_H_
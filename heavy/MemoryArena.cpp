@@ -0,0 +1,89 @@
+#include "MemoryArena.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+MemoryArena::MemoryArena() :
+	base(nullptr),
+	capacity(0),
+	used(0),
+	locked(false),
+	numRegions(0)
+{
+}
+
+MemoryArena::~MemoryArena()
+{
+	release();
+}
+
+bool MemoryArena::setup(size_t newCapacity)
+{
+	release();
+	// whole pages, so nothing else shares the locked ones
+	const size_t pageSize = sysconf(_SC_PAGESIZE);
+	newCapacity = (newCapacity + pageSize - 1) / pageSize * pageSize;
+	void* memory = mmap(nullptr, newCapacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(memory == MAP_FAILED) {
+		fprintf(stderr, "Error: cannot map %zu bytes for the memory arena: %s\n", newCapacity, strerror(errno));
+		return false;
+	}
+	base = static_cast<char*>(memory);
+	capacity = newCapacity;
+	// write every page so it is really there, then keep it there
+	for(size_t n = 0; n < capacity; n += pageSize)
+		base[n] = 0;
+	locked = mlock(base, capacity) == 0;
+	if(!locked)
+		fprintf(stderr, "Warning: cannot lock the memory arena: %s\n", strerror(errno));
+	return true;
+}
+
+void MemoryArena::release()
+{
+	if(base) {
+		if(locked)
+			munlock(base, capacity);
+		munmap(base, capacity);
+	}
+	base = nullptr;
+	capacity = 0;
+	used = 0;
+	locked = false;
+	numRegions = 0;
+}
+
+void* MemoryArena::allocate(size_t size, const char* name)
+{
+	const size_t bytes = footprint(size);
+	if(!base || bytes > capacity - used) {
+		fprintf(stderr, "Error: memory arena has %zu of %zu bytes left, %s needs %zu\n", capacity - used, capacity,
+				name, bytes);
+		return nullptr;
+	}
+	void* p = base + used;
+	used += bytes;
+	if(numRegions < kMaxRegions)
+		regions[numRegions++] = { name, bytes };
+	return p;
+}
+
+bool MemoryArena::lockProcess()
+{
+	if(mlockall(MCL_CURRENT)) {
+		fprintf(stderr, "Warning: cannot lock the process memory: %s\n", strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+void MemoryArena::printFootprint(size_t heavyBytes) const
+{
+	printf("Memory arena: %zu of %zu bytes in use%s\n", used, capacity, locked ? ", locked" : "");
+	for(unsigned int n = 0; n < numRegions; ++n)
+		printf("  %-16s %8zu\n", regions[n].name, regions[n].size);
+	printf("Heavy context: %zu bytes\n", heavyBytes);
+	printf("Total: %zu bytes\n", capacity + heavyBytes);
+}
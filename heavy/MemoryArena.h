@@ -0,0 +1,74 @@
+/*
+ * MemoryArena
+ * -----------
+ * One block of memory for the buffers render() works on, mapped, touched
+ * and locked in setup() so that none of them page faults on the first note.
+ *
+ * setup() takes the total size up front. allocate() hands out pieces of it
+ * in order, each on its own cache lines and zeroed, and records them by
+ * name for printFootprint(). Nothing is freed on its own: release() unmaps
+ * the lot in cleanup().
+ *
+ * Heavy allocates its own delay lines and message pools with hv_malloc(),
+ * which this export does not let the wrapper replace. lockProcess() locks
+ * every page the process has mapped so far, which faults those in as well,
+ * and printFootprint() counts them from hv_getSize().
+ */
+
+#ifndef MEMORYARENA_H_
+#define MEMORYARENA_H_
+
+#include <stddef.h>
+
+class MemoryArena {
+public:
+	enum {
+		kAlignment = 64,
+		kMaxRegions = 32,
+	};
+
+	MemoryArena();
+	~MemoryArena();
+
+	// Non-real-time. Returns false if the memory cannot be mapped; failing
+	// to lock it is reported and tolerated.
+	bool setup(size_t capacity);
+	void release();
+
+	// nullptr once the arena is full, which setup() should have ruled out
+	void* allocate(size_t size, const char* name);
+	template<typename T> T* allocate(size_t count, const char* name)
+	{
+		return static_cast<T*>(allocate(count * sizeof(T), name));
+	}
+
+	// What allocate() will take for size, including the padding
+	static size_t footprint(size_t size) { return (size + kAlignment - 1) / kAlignment * kAlignment; }
+
+	// mlockall() of everything mapped now
+	static bool lockProcess();
+
+	void printFootprint(size_t heavyBytes) const;
+
+	size_t getCapacity() const { return capacity; }
+	size_t getUsed() const { return used; }
+	bool isLocked() const { return locked; }
+
+private:
+	MemoryArena(const MemoryArena&);
+	MemoryArena& operator=(const MemoryArena&);
+
+	struct Region {
+		const char* name;
+		size_t size;
+	};
+
+	char* base;
+	size_t capacity;
+	size_t used;
+	bool locked;
+	Region regions[kMaxRegions];
+	unsigned int numRegions;
+};
+
+#endif // MEMORYARENA_H_
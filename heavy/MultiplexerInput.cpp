@@ -0,0 +1,44 @@
+#include "MultiplexerInput.h"
+#include <algorithm>
+#include <cmath>
+
+void MultiplexerInput::setup(unsigned int multiplexerChannels, unsigned int analogInChannels, float analogSampleRate,
+		float smoothingMs, float threshold)
+{
+	this->multiplexerChannels = multiplexerChannels;
+	this->analogInChannels = analogInChannels;
+	this->threshold = threshold;
+	// each channel is read once every multiplexerChannels analog frames
+	const float scansPerMs = multiplexerChannels ? analogSampleRate / multiplexerChannels / 1000 : 0;
+	smoothing = smoothingMs > 0 && scansPerMs > 0 ? 1 - expf(-1 / (smoothingMs * scansPerMs)) : 1;
+	primed = false;
+	smoothed.assign(getNumSlots(), 0);
+	reported.assign(getNumSlots(), 0);
+	changes.resize(getNumSlots());
+}
+
+unsigned int MultiplexerInput::process(const float* multiplexerIn, unsigned int startingChannel,
+		unsigned int analogFrames, float* table)
+{
+	if(!multiplexerChannels)
+		return 0;
+	const unsigned int numScanned = primed ? std::min(analogFrames, multiplexerChannels) : multiplexerChannels;
+	unsigned int numChanges = 0;
+	for(unsigned int n = 0; n < numScanned; ++n) {
+		const unsigned int first = (startingChannel + n) % multiplexerChannels * analogInChannels;
+		for(unsigned int slot = first; slot < first + analogInChannels; ++slot) {
+			float value = multiplexerIn[slot];
+			if(primed)
+				value = smoothed[slot] += (value - smoothed[slot]) * smoothing;
+			else
+				smoothed[slot] = value;
+			table[slot] = value;
+			if(!primed || fabsf(value - reported[slot]) > threshold) {
+				reported[slot] = value;
+				changes[numChanges++] = { slot, primed ? n : 0, value };
+			}
+		}
+	}
+	primed = true;
+	return numChanges;
+}
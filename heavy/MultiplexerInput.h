@@ -0,0 +1,54 @@
+/*
+ * MultiplexerInput
+ * ----------------
+ * Passes the multiplexed analog inputs on to the patch as the hardware
+ * scans them, instead of copying the whole array now and then.
+ *
+ * Analog frame n of a block reads multiplexer channel
+ * (multiplexerStartingChannel + n) % multiplexerChannels on every analog
+ * input, so a block refreshes analogFrames channels, or all of them. Slot
+ * m * analogInChannels + c is channel m of input c, as in
+ * multiplexerAnalogIn and the bela_multiplexer table. process() writes only
+ * the refreshed slots into the table, each through a one-pole smoother
+ * with a time constant of smoothingMs (0 for none). A slot that has moved
+ * by more than threshold since it was last reported is listed in
+ * getChange(), with the analog frame it was read in, for the caller to
+ * send on; the first scan reports every slot.
+ */
+
+#ifndef MULTIPLEXERINPUT_H_
+#define MULTIPLEXERINPUT_H_
+
+#include <vector>
+
+class MultiplexerInput {
+public:
+	struct Change {
+		unsigned int slot;
+		unsigned int frame; // analog frame of the block
+		float value;
+	};
+
+	// Non-real-time
+	void setup(unsigned int multiplexerChannels, unsigned int analogInChannels, float analogSampleRate,
+			float smoothingMs, float threshold);
+
+	// Audio thread. Returns the number of changes.
+	unsigned int process(const float* multiplexerIn, unsigned int startingChannel, unsigned int analogFrames,
+			float* table);
+
+	const Change& getChange(unsigned int n) const { return changes[n]; }
+	unsigned int getNumSlots() const { return multiplexerChannels * analogInChannels; }
+
+private:
+	unsigned int multiplexerChannels = 0;
+	unsigned int analogInChannels = 0;
+	float smoothing = 1; // one-pole coefficient per scan of a channel
+	float threshold = 0;
+	bool primed = false;
+	std::vector<float> smoothed;
+	std::vector<float> reported;
+	std::vector<Change> changes;
+};
+
+#endif // MULTIPLEXERINPUT_H_
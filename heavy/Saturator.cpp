@@ -0,0 +1,233 @@
+#include "Saturator.h"
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SATURATOR_NEON 1
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define SATURATOR_SSE 1
+#endif
+
+namespace {
+
+// The shapes and filters are written once over these, and run on four
+// samples at a time with Vector and on the leftovers with float
+template<typename V> V splat(float v);
+template<typename V> V load(const float* p);
+
+template<> inline float splat<float>(float v) { return v; }
+template<> inline float load<float>(const float* p) { return *p; }
+inline void store(float* p, float v) { *p = v; }
+inline float add(float a, float b) { return a + b; }
+inline float mul(float a, float b) { return a * b; }
+inline float min(float a, float b) { return a < b ? a : b; }
+inline float max(float a, float b) { return a > b ? a : b; }
+inline float div(float a, float b) { return a / b; }
+
+#if SATURATOR_NEON
+typedef float32x4_t Vector;
+const unsigned int kWidth = 4;
+template<> inline Vector splat<Vector>(float v) { return vdupq_n_f32(v); }
+template<> inline Vector load<Vector>(const float* p) { return vld1q_f32(p); }
+inline void store(float* p, Vector v) { vst1q_f32(p, v); }
+inline Vector add(Vector a, Vector b) { return vaddq_f32(a, b); }
+inline Vector mul(Vector a, Vector b) { return vmulq_f32(a, b); }
+inline Vector min(Vector a, Vector b) { return vminq_f32(a, b); }
+inline Vector max(Vector a, Vector b) { return vmaxq_f32(a, b); }
+inline Vector div(Vector a, Vector b)
+{
+	// armv7 has no vector divide: refine the 8-bit estimate to full precision
+	Vector r = vrecpeq_f32(b);
+	r = vmulq_f32(vrecpsq_f32(b, r), r);
+	r = vmulq_f32(vrecpsq_f32(b, r), r);
+	return vmulq_f32(a, r);
+}
+#elif SATURATOR_SSE
+typedef __m128 Vector;
+const unsigned int kWidth = 4;
+template<> inline Vector splat<Vector>(float v) { return _mm_set1_ps(v); }
+template<> inline Vector load<Vector>(const float* p) { return _mm_loadu_ps(p); }
+inline void store(float* p, Vector v) { _mm_storeu_ps(p, v); }
+inline Vector add(Vector a, Vector b) { return _mm_add_ps(a, b); }
+inline Vector mul(Vector a, Vector b) { return _mm_mul_ps(a, b); }
+inline Vector min(Vector a, Vector b) { return _mm_min_ps(a, b); }
+inline Vector max(Vector a, Vector b) { return _mm_max_ps(a, b); }
+inline Vector div(Vector a, Vector b) { return _mm_div_ps(a, b); }
+#else
+typedef float Vector;
+const unsigned int kWidth = 1;
+#endif
+
+template<typename V> inline V clip(V x, float limit)
+{
+	return min(max(x, splat<V>(-limit)), splat<V>(limit));
+}
+
+// [hv.tanh~]
+struct Pade {
+	template<typename V> V operator()(V x) const
+	{
+		x = clip(x, 3.f);
+		const V x2 = mul(x, x);
+		return div(mul(x, add(splat<V>(27.f), x2)), add(splat<V>(27.f), mul(splat<V>(9.f), x2)));
+	}
+};
+
+// tanh x = x (135135 + 17325 x^2 + 378 x^4 + x^6) / (135135 + 62370 x^2
+// + 3150 x^4 + 28 x^6), cut off where it reaches 1
+struct Rational {
+	template<typename V> V operator()(V x) const
+	{
+		x = clip(x, 4.9717869f);
+		const V x2 = mul(x, x);
+		const V num = add(splat<V>(135135.f), mul(x2, add(splat<V>(17325.f), mul(x2, add(splat<V>(378.f), x2)))));
+		const V den = add(splat<V>(135135.f), mul(x2, add(splat<V>(62370.f),
+				mul(x2, add(splat<V>(3150.f), mul(splat<V>(28.f), x2))))));
+		return div(mul(x, num), den);
+	}
+};
+
+template<typename Shape>
+void run(const float* in, float* out, unsigned int numFrames, float drive, float makeup)
+{
+	const Shape shape;
+	unsigned int n = 0;
+	const Vector d = splat<Vector>(drive);
+	const Vector m = splat<Vector>(makeup);
+	for(; n + kWidth <= numFrames; n += kWidth)
+		store(out + n, mul(shape(mul(load<Vector>(in + n), d)), m));
+	for(; n < numFrames; ++n)
+		out[n] = shape(in[n] * drive) * makeup;
+}
+
+// The sample halfway between p[0] and p[1]
+template<typename V> inline V interpolate(const float* p, const float* taps)
+{
+	V sum = splat<V>(0.f);
+	for(unsigned int j = 0; j < Saturator::kHalfBandTaps; ++j)
+		sum = add(sum, mul(splat<V>(taps[j]), add(load<V>(p - j), load<V>(p + 1 + j))));
+	return mul(sum, splat<V>(2.f));
+}
+
+// The even sample at twice the rate low-passed, from the odd ones either
+// side of it, odd[-1] and odd[0] nearest
+template<typename V> inline V decimate(const float* even, const float* odd, const float* taps)
+{
+	V sum = mul(splat<V>(0.5f), load<V>(even));
+	for(unsigned int j = 0; j < Saturator::kHalfBandTaps; ++j)
+		sum = add(sum, mul(splat<V>(taps[j]), add(load<V>(odd - 1 - j), load<V>(odd + j))));
+	return sum;
+}
+
+// modified Bessel function of the first kind, for the Kaiser window
+double besselI0(double x)
+{
+	double sum = 1;
+	double term = 1;
+	for(unsigned int k = 1; k < 32; ++k) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+} // namespace
+
+Saturator::Saturator() :
+	quality(kRational),
+	drive(1),
+	makeup(1)
+{
+	setup(quality);
+}
+
+void Saturator::setup(Quality newQuality)
+{
+	quality = newQuality;
+	// windowed sinc, Kaiser beta 7: flat to a third of the original band
+	// and 70 dB down from two thirds of it
+	const double beta = 7;
+	const unsigned int centre = 2 * kHalfBandTaps - 1;
+	double sum = 0;
+	double taps[kHalfBandTaps];
+	for(unsigned int j = 0; j < kHalfBandTaps; ++j) {
+		const unsigned int k = 2 * j + 1;
+		const double r = (double)k / centre;
+		const double window = besselI0(beta * sqrt(1 - r * r)) / besselI0(beta);
+		taps[j] = (j & 1 ? -1 : 1) / (M_PI * k) * window;
+		sum += taps[j];
+	}
+	for(unsigned int j = 0; j < kHalfBandTaps; ++j)
+		halfBand[j] = taps[j] * 0.25 / sum;
+	reset();
+}
+
+void Saturator::reset()
+{
+	std::fill_n(inputHistory, 2 * kHalfBandTaps - 1, 0.f);
+	std::fill_n(evenHistory, kHalfBandTaps, 0.f);
+	std::fill_n(oddHistory, 2 * kHalfBandTaps, 0.f);
+}
+
+void Saturator::setDrive(float newDrive)
+{
+	drive = newDrive;
+	makeup = 1 / sqrtf(drive);
+}
+
+void Saturator::process(const float* in, float* out, unsigned int numFrames)
+{
+	if(quality == kOversampled)
+		processOversampled(in, out, numFrames);
+	else
+		shape(in, out, numFrames);
+}
+
+void Saturator::shape(const float* in, float* out, unsigned int numFrames) const
+{
+	if(quality == kPade)
+		run<Pade>(in, out, numFrames, drive, makeup);
+	else
+		run<Rational>(in, out, numFrames, drive, makeup);
+}
+
+void Saturator::processOversampled(const float* in, float* out, unsigned int numFrames)
+{
+	const unsigned int k = kHalfBandTaps;
+	while(numFrames) {
+		const unsigned int frames = std::min(numFrames, (unsigned int)kChunk);
+		memcpy(inputHistory + 2 * k - 1, in, frames * sizeof(float));
+
+		// up: the input delayed by k frames, and the samples halfway
+		float* even = evenHistory + k;
+		float* odd = oddHistory + 2 * k;
+		unsigned int n = 0;
+		for(; n + kWidth <= frames; n += kWidth) {
+			store(even + n, load<Vector>(inputHistory + k - 1 + n));
+			store(odd + n, interpolate<Vector>(inputHistory + k - 1 + n, halfBand));
+		}
+		for(; n < frames; ++n) {
+			even[n] = inputHistory[k - 1 + n];
+			odd[n] = interpolate<float>(inputHistory + k - 1 + n, halfBand);
+		}
+
+		run<Rational>(even, even, frames, drive, makeup);
+		run<Rational>(odd, odd, frames, drive, makeup);
+
+		// down, another k frames later
+		for(n = 0; n + kWidth <= frames; n += kWidth)
+			store(out + n, decimate<Vector>(evenHistory + n, oddHistory + k + n, halfBand));
+		for(; n < frames; ++n)
+			out[n] = decimate<float>(evenHistory + n, oddHistory + k + n, halfBand);
+
+		memmove(inputHistory, inputHistory + frames, (2 * k - 1) * sizeof(float));
+		memmove(evenHistory, evenHistory + frames, k * sizeof(float));
+		memmove(oddHistory, oddHistory + frames, 2 * k * sizeof(float));
+		in += frames;
+		out += frames;
+		numFrames -= frames;
+	}
+}
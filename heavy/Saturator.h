@@ -0,0 +1,69 @@
+/*
+ * Saturator
+ * ---------
+ * The dist subpatch of filters~ as one vectorised kernel: y = tanh(drive x)
+ * / sqrt(drive), four samples at a time with NEON or SSE.
+ *
+ * The patch builds it from [hv.tanh~], which clips at +-3 and takes the Pade
+ * approximant x (27 + x^2) / (27 + 9 x^2), followed by [sqrt~] and [/~], each
+ * a separate pass over the signal. The shapes trade accuracy for CPU:
+ *
+ *   kPade        the same approximant, error up to 2.4e-2 against tanh
+ *   kRational    Lambert's 7/6 continued fraction, clipped where it reaches
+ *                1 at +-4.97, error up to 1e-4; two more multiplies
+ *   kOversampled kRational at twice the rate, through half-band filters
+ *                with kHalfBandTaps taps either side of the centre, so the
+ *                harmonics above Nyquist are mostly filtered out rather
+ *                than folded back. Delays by getLatency() frames
+ *
+ * Division goes through a reciprocal estimate refined twice on NEON, where
+ * Heavy's [/~] uses the bare 8-bit estimate.
+ */
+
+#ifndef SATURATOR_H_
+#define SATURATOR_H_
+
+class Saturator {
+public:
+	enum Quality {
+		kPade,
+		kRational,
+		kOversampled,
+	};
+	static constexpr unsigned int kHalfBandTaps = 8; // on each side of the centre
+
+	Saturator();
+
+	void setup(Quality quality);
+	// Clear the oversampling filters
+	void reset();
+
+	// drive > 0, as distparam gives it. The patch glides drive over 50 ms;
+	// call this once per block to do the same.
+	void setDrive(float drive);
+
+	// in and out may be the same buffer
+	void process(const float* in, float* out, unsigned int numFrames);
+
+	Quality getQuality() const { return quality; }
+	unsigned int getLatency() const { return quality == kOversampled ? 2 * kHalfBandTaps : 0; }
+
+private:
+	enum { kChunk = 64 }; // frames oversampled at a time
+
+	void shape(const float* in, float* out, unsigned int numFrames) const;
+	void processOversampled(const float* in, float* out, unsigned int numFrames);
+
+	Quality quality;
+	float drive;
+	float makeup; // 1 / sqrt(drive)
+	float halfBand[kHalfBandTaps]; // the odd taps from the centre out, which sum to 1/4
+
+	// kOversampled only: the input, and the even and odd samples at twice
+	// the rate, each after the history the filters look back on
+	float inputHistory[2 * kHalfBandTaps - 1 + kChunk];
+	float evenHistory[kHalfBandTaps + kChunk];
+	float oddHistory[2 * kHalfBandTaps + kChunk];
+};
+
+#endif // SATURATOR_H_
@@ -0,0 +1,140 @@
+#include "ScopeCapture.h"
+#include <algorithm>
+#include <string.h>
+
+void ScopeCapture::setup(unsigned int numChannels, unsigned int decimation, Mode mode, unsigned int preFrames,
+		unsigned int postFrames, unsigned int triggerChannel, float triggerLevel)
+{
+	this->numChannels = numChannels;
+	this->decimation = std::max(1u, decimation);
+	this->mode = mode;
+	this->preFrames = preFrames;
+	this->postFrames = std::max(1u, postFrames);
+	this->triggerChannel = std::min(triggerChannel, numChannels ? numChannels - 1 : 0);
+	this->triggerLevel = triggerLevel;
+	uint64_t ringFrames = kMinRingFrames;
+	while(ringFrames < 2 * (this->preFrames + this->postFrames))
+		ringFrames *= 2;
+	ring.assign(ringFrames * numChannels, 0);
+	ringMask = ringFrames - 1;
+	// free running, the task is woken every quarter ring. The writer is
+	// up to a block ahead of what it has published, so the task stays a
+	// quarter ring clear of it as well.
+	flushFrames = ringFrames / 4;
+	safeFrames = ringFrames - flushFrames;
+
+	phase = 0;
+	lastTriggerSample = 0;
+	writeFrame = 0;
+	notifiedFrame = 0;
+	pending = false;
+	ignored = 0;
+	ready.store(false);
+	written.store(0);
+	readFrame = 0;
+	reading = false;
+	lost = 0;
+}
+
+bool ScopeCapture::startCapture(uint64_t triggerFrame)
+{
+	if(pending || ready.load(std::memory_order_acquire)) {
+		++ignored;
+		return false;
+	}
+	pendingTrigger = triggerFrame;
+	pending = true;
+	return true;
+}
+
+void ScopeCapture::trigger(unsigned int frame)
+{
+	if(mode == kOnTrigger && numChannels)
+		startCapture(writeFrame + (frame > phase ? (frame - phase + decimation - 1) / decimation : 0));
+}
+
+bool ScopeCapture::write(const float* channels, unsigned int channelStride, unsigned int numFrames)
+{
+	if(!numChannels)
+		return false;
+	unsigned int n = phase;
+	for(; n < numFrames; n += decimation) {
+		float* frame = &ring[(writeFrame & ringMask) * numChannels];
+		for(unsigned int c = 0; c < numChannels; ++c)
+			frame[c] = channels[c * channelStride + n];
+		if(mode == kOnLevel) {
+			const float sample = frame[triggerChannel];
+			if(lastTriggerSample < triggerLevel && sample >= triggerLevel)
+				startCapture(writeFrame);
+			lastTriggerSample = sample;
+		}
+		++writeFrame;
+	}
+	phase = n - numFrames;
+	written.store(writeFrame, std::memory_order_release);
+
+	if(mode == kFreeRun) {
+		if(writeFrame - notifiedFrame < flushFrames)
+			return false;
+		notifiedFrame = writeFrame;
+		return true;
+	}
+	if(!pending || writeFrame < pendingTrigger + postFrames)
+		return false;
+	captureStart = pendingTrigger > preFrames ? pendingTrigger - preFrames : 0;
+	captureEnd = pendingTrigger + postFrames;
+	captureTrigger = pendingTrigger;
+	pending = false;
+	ready.store(true, std::memory_order_release);
+	return true;
+}
+
+unsigned int ScopeCapture::read(float* frames, unsigned int maxFrames, int& triggerIndex)
+{
+	triggerIndex = -1;
+	uint64_t end;
+	if(mode == kFreeRun) {
+		end = written.load(std::memory_order_acquire);
+	} else {
+		if(!ready.load(std::memory_order_acquire))
+			return 0;
+		if(!reading) {
+			readFrame = captureStart;
+			reading = true;
+		}
+		end = captureEnd;
+	}
+	// a batch that was overwritten in full is skipped for the next one
+	for(;;) {
+		uint64_t now = written.load(std::memory_order_acquire);
+		if(now - readFrame > safeFrames) {
+			// overwritten before the task got to it
+			const uint64_t skip = now - safeFrames - readFrame;
+			lost += std::min(skip, end - readFrame);
+			readFrame = std::min(now - safeFrames, end);
+		}
+		const uint64_t start = readFrame;
+		const unsigned int count = std::min<uint64_t>(maxFrames, end - start);
+		for(unsigned int n = 0; n < count; ++n)
+			memcpy(frames + n * numChannels, &ring[((start + n) & ringMask) * numChannels], numChannels * sizeof(float));
+		// anything the writer reached while copying is torn
+		now = written.load(std::memory_order_acquire);
+		unsigned int valid = count;
+		if(now > start + safeFrames)
+			valid = now - safeFrames - start >= count ? 0 : count - (now - safeFrames - start);
+		if(valid < count) {
+			lost += count - valid;
+			memmove(frames, frames + (count - valid) * numChannels, valid * numChannels * sizeof(float));
+		}
+		const uint64_t first = start + count - valid;
+		if(mode != kFreeRun && captureTrigger >= first && captureTrigger < first + valid)
+			triggerIndex = captureTrigger - first;
+		readFrame = start + count;
+		if(mode != kFreeRun && readFrame >= captureEnd) {
+			reading = false;
+			ready.store(false, std::memory_order_release);
+		}
+		if(valid || !count || (mode != kFreeRun && !reading))
+			return valid;
+	}
+}
@@ -0,0 +1,94 @@
+/*
+ * ScopeCapture
+ * ------------
+ * Takes the scope channels off the audio thread a block at a time, so that
+ * the per-frame Scope::log() calls happen in an auxiliary task instead.
+ *
+ * write() keeps every decimation-th frame of the channels in a ring,
+ * interleaved, and counts what it has written. In kFreeRun everything is
+ * passed on. In kOnTrigger and kOnLevel only a capture is: preFrames
+ * before the trigger and postFrames from it, the trigger being a call to
+ * trigger() or, in kOnLevel, the trigger channel rising through the level.
+ * A trigger that comes while a capture is still being read is ignored.
+ * Frames are counted after decimation.
+ *
+ * write() returns true when there is enough to read, and the task then
+ * read()s it out in batches. Neither side waits for the other. The ring
+ * holds at least twice a capture; if the task falls most of a ring
+ * behind, read() drops what may have been overwritten and counts it as
+ * lost.
+ */
+
+#ifndef SCOPECAPTURE_H_
+#define SCOPECAPTURE_H_
+
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+class ScopeCapture {
+public:
+	enum Mode {
+		kFreeRun,
+		kOnTrigger,
+		kOnLevel,
+	};
+
+	enum { kMinRingFrames = 4096 };
+
+	// Non-real-time
+	void setup(unsigned int numChannels, unsigned int decimation, Mode mode, unsigned int preFrames,
+			unsigned int postFrames, unsigned int triggerChannel = 0, float triggerLevel = 0);
+
+	// Audio thread. Channel c of frame n is at channels[c * channelStride + n].
+	bool write(const float* channels, unsigned int channelStride, unsigned int numFrames);
+	// In kOnTrigger, at frame frame of the next block written
+	void trigger(unsigned int frame);
+
+	// Auxiliary task. Copies up to maxFrames interleaved frames and returns
+	// how many; triggerIndex is the trigger's frame among them, or -1.
+	unsigned int read(float* frames, unsigned int maxFrames, int& triggerIndex);
+
+	unsigned int getNumChannels() const { return numChannels; }
+	unsigned int getDecimation() const { return decimation; }
+	uint64_t getIgnoredTriggers() const { return ignored; }
+	uint64_t getLostFrames() const { return lost; }
+
+private:
+	bool startCapture(uint64_t triggerFrame);
+
+	unsigned int numChannels = 0;
+	unsigned int decimation = 1;
+	Mode mode = kFreeRun;
+	uint64_t preFrames = 0;
+	uint64_t postFrames = 0;
+	unsigned int triggerChannel = 0;
+	float triggerLevel = 0;
+	std::vector<float> ring;
+	uint64_t ringMask = 0;
+	uint64_t flushFrames = 0;
+	uint64_t safeFrames = 0;
+
+	// audio thread
+	unsigned int phase = 0; // input frames until the next one kept
+	float lastTriggerSample = 0;
+	uint64_t writeFrame = 0;
+	uint64_t notifiedFrame = 0;
+	uint64_t pendingTrigger = 0;
+	bool pending = false;
+	uint64_t ignored = 0;
+
+	// handed to the task while ready is set
+	uint64_t captureStart = 0;
+	uint64_t captureEnd = 0;
+	uint64_t captureTrigger = 0;
+	std::atomic<bool> ready { false };
+	std::atomic<uint64_t> written { 0 };
+
+	// auxiliary task
+	uint64_t readFrame = 0;
+	bool reading = false;
+	uint64_t lost = 0;
+};
+
+#endif // SCOPECAPTURE_H_
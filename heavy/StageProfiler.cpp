@@ -0,0 +1,107 @@
+#include "StageProfiler.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+void StageProfiler::setup(const char* const* stageNames, unsigned int numStages, uint32_t budgetNs,
+		uint32_t windowBlocks, float outlierFraction)
+{
+	this->stageNames = stageNames;
+	this->numStages = std::min(numStages, (unsigned int)kMaxStages);
+	this->budgetNs = budgetNs;
+	this->windowBlocks = std::max(1u, windowBlocks);
+	outlierNs = budgetNs * outlierFraction;
+	memset(stageNs, 0, sizeof(stageNs));
+	memset(&window, 0, sizeof(window));
+	memset(buffers, 0, sizeof(buffers));
+	back = 0;
+	front = 1;
+	middle.store(2);
+	startWindow();
+}
+
+void StageProfiler::add(StageStats& stats, uint32_t ns)
+{
+	++stats.count;
+	stats.totalNs += ns;
+	stats.minNs = std::min(stats.minNs, ns);
+	stats.maxNs = std::max(stats.maxNs, ns);
+	// bucket b holds times below 2^b us, 1 us taken as 1024 ns
+	unsigned int us = ns >> 10;
+	unsigned int bucket = us ? 32 - __builtin_clz(us) : 0;
+	++stats.histogram[std::min(bucket, (unsigned int)kHistogramBuckets - 1)];
+}
+
+void StageProfiler::clear(StageStats& stats)
+{
+	memset(&stats, 0, sizeof(stats));
+	stats.minNs = UINT32_MAX;
+}
+
+void StageProfiler::startWindow()
+{
+	for(unsigned int n = 0; n < numStages; ++n)
+		clear(window.stages[n]);
+	clear(window.total);
+	memset(window.worstBlockNs, 0, sizeof(window.worstBlockNs));
+	window.blocks = 0;
+	window.outliers = 0;
+	window.budgetNs = budgetNs;
+	worstNs = 0;
+}
+
+bool StageProfiler::endBlock()
+{
+	const uint32_t blockNs = last - blockStart;
+	add(window.total, blockNs);
+	if(blockNs > outlierNs) {
+		++window.outliers;
+		if(blockNs > worstNs) {
+			worstNs = blockNs;
+			memcpy(window.worstBlockNs, stageNs, sizeof(stageNs));
+		}
+	}
+	if(++window.blocks < windowBlocks)
+		return false;
+
+	++window.window;
+	memcpy(&buffers[back], &window, sizeof(window));
+	back = middle.exchange(back | kFresh, std::memory_order_acq_rel) & ~kFresh;
+	startWindow();
+	return true;
+}
+
+bool StageProfiler::read(Snapshot& snapshot)
+{
+	if(!(middle.load(std::memory_order_relaxed) & kFresh))
+		return false;
+	front = middle.exchange(front, std::memory_order_acq_rel) & ~kFresh;
+	memcpy(&snapshot, &buffers[front], sizeof(snapshot));
+	return true;
+}
+
+void StageProfiler::print(const Snapshot& s) const
+{
+	const float budgetUs = s.budgetNs / 1000.f;
+	printf("Profile %llu: %u blocks, budget %.1f us, %u over %.0f%% of it\n",
+			(unsigned long long)s.window, s.blocks, budgetUs, s.outliers, 100.f * outlierNs / s.budgetNs);
+	printf("  %-12s %8s %8s %8s %7s %8s  histogram <1 <2 <4 ... us\n",
+			"stage", "mean us", "min us", "max us", "budget", "worst");
+	for(unsigned int n = 0; n <= numStages; ++n) {
+		const StageStats& st = n < numStages ? s.stages[n] : s.total;
+		if(!st.count)
+			continue;
+		const float meanUs = st.totalNs / 1000.f / st.count;
+		uint32_t worst = 0;
+		for(unsigned int k = 0; k < numStages; ++k)
+			worst += (n == numStages || n == k) ? s.worstBlockNs[k] : 0;
+		printf("  %-12s %8.2f %8.2f %8.2f %6.1f%% %8.2f  ", n < numStages ? stageNames[n] : "total",
+				meanUs, st.minNs / 1000.f, st.maxNs / 1000.f, 100.f * meanUs / budgetUs, worst / 1000.f);
+		unsigned int last = kHistogramBuckets;
+		while(last > 1 && !st.histogram[last - 1])
+			--last;
+		for(unsigned int b = 0; b < last; ++b)
+			printf(" %u", st.histogram[b]);
+		printf("\n");
+	}
+}
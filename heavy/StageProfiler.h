@@ -0,0 +1,116 @@
+/*
+ * StageProfiler
+ * -------------
+ * Times the stages of render() on the audio thread and hands the numbers to
+ * an auxiliary task to print.
+ *
+ * render() calls beginBlock(), then endStage() after every stage and
+ * endBlock() at the end. Each call reads the monotonic clock once, about as
+ * close to the cycle count as the board lets user code get, and updates a
+ * few counters. Per stage there is the count, mean, min, max and a
+ * histogram with power of two buckets from 1 us up. A block that takes more
+ * than outlierFraction of its budget is counted as an outlier, and the
+ * stage times of the worst one are kept, which is where an xrun would come
+ * from.
+ *
+ * Every windowBlocks endBlock() publishes the window into a triple buffer
+ * and starts a new one. It returns true when it did, so the caller can
+ * schedule the task that read()s and prints the snapshot. Neither side
+ * waits for the other, and a window the reader did not pick up in time is
+ * overwritten by the next one.
+ */
+
+#ifndef STAGEPROFILER_H_
+#define STAGEPROFILER_H_
+
+#include <atomic>
+#include <stdint.h>
+#include <time.h>
+
+class StageProfiler {
+public:
+	enum {
+		kMaxStages = 16,
+		kHistogramBuckets = 16, // bucket b counts times below 2^b us
+	};
+
+	struct StageStats {
+		uint64_t count;
+		uint64_t totalNs;
+		uint32_t minNs;
+		uint32_t maxNs;
+		uint32_t histogram[kHistogramBuckets];
+	};
+
+	struct Snapshot {
+		uint64_t window; // windows published so far
+		uint32_t blocks;
+		uint32_t outliers;
+		uint32_t budgetNs;
+		StageStats stages[kMaxStages];
+		StageStats total;
+		uint32_t worstBlockNs[kMaxStages]; // stage times of the slowest outlier
+	};
+
+	// stageNames must outlive the profiler
+	void setup(const char* const* stageNames, unsigned int numStages, uint32_t budgetNs,
+			uint32_t windowBlocks, float outlierFraction = 0.8f);
+
+	void beginBlock()
+	{
+		blockStart = last = now();
+	}
+
+	void endStage(unsigned int stage)
+	{
+		const uint32_t t = now();
+		stageNs[stage] = t - last;
+		add(window.stages[stage], t - last);
+		last = t;
+	}
+
+	bool endBlock();
+
+	// Auxiliary task. Returns false if nothing new was published.
+	bool read(Snapshot& snapshot);
+	void print(const Snapshot& snapshot) const;
+
+	unsigned int getNumStages() const { return numStages; }
+	const char* getStageName(unsigned int stage) const { return stageNames[stage]; }
+
+private:
+	static uint32_t now()
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1000000000u + ts.tv_nsec;
+	}
+
+	static void add(StageStats& stats, uint32_t ns);
+	static void clear(StageStats& stats);
+	void startWindow();
+
+	const char* const* stageNames = nullptr;
+	unsigned int numStages = 0;
+	uint32_t budgetNs = 0;
+	uint32_t outlierNs = 0;
+	uint32_t windowBlocks = 0;
+
+	// audio thread
+	uint32_t blockStart = 0;
+	uint32_t last = 0;
+	uint32_t stageNs[kMaxStages];
+	uint32_t worstNs = 0;
+	Snapshot window;
+
+	// triple buffer: the writer fills buffers[back], then swaps it with the
+	// middle one and marks it fresh, the reader swaps the middle one with
+	// buffers[front] when it is fresh
+	enum { kFresh = 4 };
+	Snapshot buffers[3];
+	unsigned int back = 0;
+	unsigned int front = 1;
+	std::atomic<unsigned int> middle { 2 };
+};
+
+#endif // STAGEPROFILER_H_
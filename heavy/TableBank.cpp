@@ -0,0 +1,63 @@
+#include "TableBank.h"
+#include "TableBlob.h"
+#include <Heavy_bela.h>
+#include <stdio.h>
+#include <string.h>
+
+void TableBank::setup(HeavyContextInterface* context, unsigned int maxTables, unsigned int maxFloats)
+{
+	this->context = context;
+	copies.resize(maxTables);
+	values.resize(maxFloats);
+	numCopies = 0;
+	staged.store(false);
+}
+
+bool TableBank::stage(const TableBlob& blob)
+{
+	if(!context || staged.load(std::memory_order_acquire))
+		return false;
+
+	// only looks tables up, the patch does not resize them while running
+	unsigned int n = 0;
+	uint32_t offset = 0;
+	for(unsigned int t = 0; t < blob.getNumTables(); ++t) {
+		const TableBlob::Entry& e = blob.getEntry(t);
+		const hv_uint32_t hash = hv_stringToHash(e.name);
+		float* destination = hv_table_getBuffer(context, hash);
+		if(!destination) {
+			fprintf(stderr, "Warning: the patch has no table %s\n", e.name);
+			continue;
+		}
+		if(hv_table_getLength(context, hash) != e.length) {
+			fprintf(stderr, "Warning: %s has %u values, the patch has %u, restart to load it\n",
+					e.name, e.length, hv_table_getLength(context, hash));
+			continue;
+		}
+		if(n == copies.size() || e.length > values.size() - offset) {
+			fprintf(stderr, "Warning: no room to stage %s\n", e.name);
+			continue;
+		}
+		memcpy(&values[offset], blob.getValues(t), e.length * sizeof(float));
+		copies[n].destination = destination;
+		copies[n].offset = offset;
+		copies[n].length = e.length;
+		offset += e.length;
+		++n;
+	}
+	if(n == 0)
+		return false;
+	numCopies = n;
+	staged.store(true, std::memory_order_release);
+	return true;
+}
+
+bool TableBank::apply()
+{
+	if(!staged.load(std::memory_order_acquire))
+		return false;
+	for(unsigned int n = 0; n < numCopies; ++n)
+		memcpy(copies[n].destination, &values[copies[n].offset], copies[n].length * sizeof(float));
+	staged.store(false, std::memory_order_release);
+	return true;
+}
@@ -0,0 +1,54 @@
+/*
+ * TableBank
+ * ---------
+ * Swaps a new set of voicing tables into the running patch.
+ *
+ * The patch's own tables are the live set. A non-real-time thread stages a
+ * new set from a TableBlob with stage(), into buffers allocated in setup().
+ * render() then calls apply() at the start of the block, which copies the
+ * whole staged set into the Heavy tables in one go, so no block ever sees a
+ * mix of old and new tables. The two sides hand the staged set over through
+ * a single atomic flag: apply() takes no locks, allocates nothing and does
+ * nothing while no set is staged.
+ *
+ * Tables can only be swapped at the length they have in the patch, since
+ * resizing a Heavy table allocates. Tables with another length, or that the
+ * patch does not have, are left out with a warning.
+ */
+
+#ifndef TABLEBANK_H_
+#define TABLEBANK_H_
+
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+class HeavyContextInterface;
+class TableBlob;
+
+class TableBank {
+public:
+	void setup(HeavyContextInterface* context, unsigned int maxTables = 64, unsigned int maxFloats = 8192);
+
+	// Non-real-time. Returns false if the previous set has not been applied
+	// yet or nothing in blob fits.
+	bool stage(const TableBlob& blob);
+	bool isStaged() const { return staged.load(std::memory_order_acquire); }
+	// Audio thread, between blocks. Returns true if a staged set was applied.
+	bool apply();
+
+private:
+	struct Copy {
+		float* destination; // the Heavy table
+		uint32_t offset; // into values
+		uint32_t length;
+	};
+
+	HeavyContextInterface* context = nullptr;
+	std::vector<Copy> copies;
+	std::vector<float> values;
+	unsigned int numCopies = 0;
+	std::atomic<bool> staged { false };
+};
+
+#endif // TABLEBANK_H_
@@ -0,0 +1,154 @@
+#include "TableBlob.h"
+#include <Heavy_bela.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char kMagic[4] = { 'T', 'Y', 'T', 'B' };
+
+TableBlob::~TableBlob()
+{
+	close();
+}
+
+uint32_t TableBlob::checksum(const void* data, size_t size)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	uint32_t hash = 2166136261u;
+	for(size_t n = 0; n < size; ++n)
+		hash = (hash ^ bytes[n]) * 16777619u;
+	return hash;
+}
+
+bool TableBlob::open(const char* path)
+{
+	close();
+	int fd = ::open(path, O_RDONLY);
+	if(fd < 0) {
+		fprintf(stderr, "Error: cannot open %s: %s\n", path, strerror(errno));
+		return false;
+	}
+	struct stat st;
+	if(fstat(fd, &st) || st.st_size < (off_t)sizeof(Header)) {
+		fprintf(stderr, "Error: %s is too short for a table file\n", path);
+		::close(fd);
+		return false;
+	}
+	void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(map == MAP_FAILED) {
+		fprintf(stderr, "Error: cannot map %s: %s\n", path, strerror(errno));
+		return false;
+	}
+
+	const Header* h = (const Header*)map;
+	const Entry* e = (const Entry*)(h + 1);
+	const size_t size = st.st_size;
+	const char* error = nullptr;
+	if(memcmp(h->magic, kMagic, sizeof(kMagic)))
+		error = "not a table file";
+	else if(h->version != kVersion)
+		error = "unsupported version";
+	else if(size != sizeof(Header) + (size_t)h->numTables * sizeof(Entry) + (size_t)h->numFloats * sizeof(float))
+		error = "wrong size";
+	else if(h->checksum != checksum(e, size - sizeof(Header)))
+		error = "bad checksum";
+	const float* values = (const float*)(e + h->numTables);
+	for(unsigned int n = 0; !error && n < h->numTables; ++n) {
+		if(memchr(e[n].name, 0, sizeof(e[n].name)) == nullptr || e[n].offset > h->numFloats
+				|| e[n].length > h->numFloats - e[n].offset)
+			error = "bad table entry";
+		else if(e[n].checksum != checksum(values + e[n].offset, e[n].length * sizeof(float)))
+			error = "bad table checksum";
+	}
+	if(error) {
+		fprintf(stderr, "Error: %s: %s\n", path, error);
+		munmap(map, size);
+		return false;
+	}
+
+	mapping = map;
+	mappingSize = size;
+	header = h;
+	entries = e;
+	data = values;
+	return true;
+}
+
+void TableBlob::close()
+{
+	if(mapping)
+		munmap(mapping, mappingSize);
+	mapping = nullptr;
+	mappingSize = 0;
+	header = nullptr;
+	entries = nullptr;
+	data = nullptr;
+}
+
+unsigned int TableBlob::bind(HeavyContextInterface* context) const
+{
+	unsigned int found = 0;
+	for(unsigned int n = 0; n < getNumTables(); ++n) {
+		const Entry& e = entries[n];
+		const hv_uint32_t hash = hv_stringToHash(e.name);
+		if(hv_table_getBuffer(context, hash) == nullptr || e.length == 0) {
+			fprintf(stderr, "Warning: the patch has no table %s\n", e.name);
+			continue;
+		}
+		if(hv_table_getLength(context, hash) != e.length)
+			hv_table_setLength(context, hash, e.length);
+		memcpy(hv_table_getBuffer(context, hash), getValues(n), e.length * sizeof(float));
+		++found;
+	}
+	return found;
+}
+
+bool TableBlob::write(const char* path, const std::vector<Table>& tables)
+{
+	Header h;
+	memcpy(h.magic, kMagic, sizeof(kMagic));
+	h.version = kVersion;
+	h.numTables = tables.size();
+	h.numFloats = 0;
+
+	std::vector<Entry> e(tables.size());
+	std::vector<float> values;
+	for(unsigned int n = 0; n < tables.size(); ++n) {
+		if(tables[n].name.size() > kMaxNameLength) {
+			fprintf(stderr, "Error: table name %s is longer than %d characters\n",
+					tables[n].name.c_str(), kMaxNameLength);
+			return false;
+		}
+		memset(e[n].name, 0, sizeof(e[n].name));
+		memcpy(e[n].name, tables[n].name.data(), tables[n].name.size());
+		e[n].offset = values.size();
+		e[n].length = tables[n].values.size();
+		e[n].checksum = checksum(tables[n].values.data(), e[n].length * sizeof(float));
+		values.insert(values.end(), tables[n].values.begin(), tables[n].values.end());
+	}
+	h.numFloats = values.size();
+
+	std::vector<char> body(e.size() * sizeof(Entry) + values.size() * sizeof(float));
+	if(!e.empty())
+		memcpy(body.data(), e.data(), e.size() * sizeof(Entry));
+	if(!values.empty())
+		memcpy(body.data() + e.size() * sizeof(Entry), values.data(), values.size() * sizeof(float));
+	h.checksum = checksum(body.data(), body.size());
+
+	FILE* f = fopen(path, "wb");
+	if(!f) {
+		fprintf(stderr, "Error: cannot write %s: %s\n", path, strerror(errno));
+		return false;
+	}
+	bool ok = fwrite(&h, sizeof(h), 1, f) == 1
+		&& fwrite(body.data(), 1, body.size(), f) == body.size();
+	ok = (fclose(f) == 0) && ok;
+	if(!ok)
+		fprintf(stderr, "Error: cannot write %s\n", path);
+	return ok;
+}
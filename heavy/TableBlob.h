@@ -0,0 +1,88 @@
+/*
+ * TableBlob
+ * ---------
+ * The voicing tables (t-*, f-* and g-* in tables/) compiled into one binary
+ * file, so a different voicing can be loaded into the Heavy tables at
+ * startup without exporting the patch again. tablepack in host/ writes it.
+ *
+ * Layout, little endian as on the board and the host:
+ *
+ *   Header
+ *   Entry[numTables]
+ *   float[numFloats]   the tables back to back
+ *
+ * header.checksum covers everything after the header, and every entry
+ * carries the checksum of its own values, so a bad file is refused before
+ * anything is written into the patch.
+ */
+
+#ifndef TABLEBLOB_H_
+#define TABLEBLOB_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class HeavyContextInterface;
+
+class TableBlob {
+public:
+	enum {
+		kVersion = 1,
+		kMaxNameLength = 23,
+	};
+
+	struct Header {
+		char magic[4]; // "TYTB"
+		uint32_t version;
+		uint32_t numTables;
+		uint32_t numFloats;
+		uint32_t checksum;
+	};
+
+	struct Entry {
+		char name[kMaxNameLength + 1]; // table name in the patch
+		uint32_t offset; // in floats from the start of the data
+		uint32_t length;
+		uint32_t checksum;
+	};
+
+	struct Table {
+		std::string name;
+		std::vector<float> values;
+	};
+
+	TableBlob() {}
+	~TableBlob();
+
+	// Maps the file and checks it. Prints why and returns false if it
+	// cannot be used.
+	bool open(const char* path);
+	void close();
+	bool isOpen() const { return header != nullptr; }
+
+	unsigned int getNumTables() const { return header ? header->numTables : 0; }
+	const Entry& getEntry(unsigned int n) const { return entries[n]; }
+	const float* getValues(unsigned int n) const { return data + entries[n].offset; }
+
+	// Copies every table into the Heavy table of the same name, resizing
+	// it if the length differs. Returns how many tables were found.
+	unsigned int bind(HeavyContextInterface* context) const;
+
+	static bool write(const char* path, const std::vector<Table>& tables);
+	// FNV-1a
+	static uint32_t checksum(const void* data, size_t size);
+
+private:
+	TableBlob(const TableBlob&);
+	TableBlob& operator=(const TableBlob&);
+
+	void* mapping = nullptr;
+	size_t mappingSize = 0;
+	const Header* header = nullptr;
+	const Entry* entries = nullptr;
+	const float* data = nullptr;
+};
+
+#endif // TABLEBLOB_H_
@@ -0,0 +1,43 @@
+#include "Tremolo.h"
+#include <algorithm>
+#include <cmath>
+
+float Tremolo::table[kTableSize + 1];
+
+bool Tremolo::fillTable()
+{
+	for(unsigned int n = 0; n <= kTableSize; ++n)
+		table[n] = sinf(2.0 * M_PI * n / kTableSize);
+	return true;
+}
+
+void Tremolo::setup(float sampleRate, float rateHz, float depth, float smoothingMs)
+{
+	// once, even with tremolos set up on several threads
+	static const bool filled = fillTable();
+	(void)filled;
+	this->sampleRate = sampleRate;
+	this->depth = depth;
+	smoothing = 1.f - expf(-1000.f / (smoothingMs * sampleRate));
+	phase = 0;
+	setRate(rateHz);
+	increment = targetIncrement;
+}
+
+void Tremolo::setRate(float rateHz)
+{
+	rateHz = std::max(0.f, std::min(rateHz, sampleRate * 0.5f));
+	targetIncrement = rateHz / sampleRate * 4294967296.f;
+}
+
+void Tremolo::process(float* gain, unsigned int numFrames)
+{
+	const float fractionScale = 1.f / (1 << kFractionBits);
+	for(unsigned int n = 0; n < numFrames; ++n) {
+		const uint32_t index = phase >> kFractionBits;
+		const float fraction = (phase & ((1u << kFractionBits) - 1)) * fractionScale;
+		gain[n] = depth * (table[index] + fraction * (table[index + 1] - table[index]));
+		increment += (targetIncrement - increment) * smoothing;
+		phase += (uint32_t)increment;
+	}
+}
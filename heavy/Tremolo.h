@@ -0,0 +1,43 @@
+/*
+ * Tremolo
+ * -------
+ * Low frequency sine that scales the audio outputs, one gain per sample.
+ *
+ * The phase is a 32-bit accumulator that wraps by itself, and the sine is
+ * read from a small table with linear interpolation, which is well below
+ * audible error at tremolo rates and much cheaper than sinf() per sample.
+ * Rate changes from the patch glide to the new rate over smoothingMs so the
+ * modulation does not jump.
+ */
+
+#ifndef TREMOLO_H_
+#define TREMOLO_H_
+
+#include <stdint.h>
+
+class Tremolo {
+public:
+	void setup(float sampleRate, float rateHz, float depth, float smoothingMs = 20);
+	void setRate(float rateHz);
+
+	// Writes depth * sin() for the next numFrames samples
+	void process(float* gain, unsigned int numFrames);
+
+private:
+	enum {
+		kTableBits = 9,
+		kTableSize = 1 << kTableBits,
+		kFractionBits = 32 - kTableBits,
+	};
+	static float table[kTableSize + 1]; // one full period plus a guard point
+	static bool fillTable();
+
+	float sampleRate;
+	float depth;
+	float smoothing; // one-pole coefficient per sample
+	float increment; // phase steps per sample, in 2^32 per period
+	float targetIncrement;
+	uint32_t phase;
+};
+
+#endif // TREMOLO_H_
@@ -0,0 +1,93 @@
+#include "VoiceAllocator.h"
+#include <algorithm>
+
+VoiceAllocator::VoiceAllocator() :
+	numVoices(0),
+	tailFrames(0)
+{
+	reset();
+}
+
+void VoiceAllocator::setup(unsigned int newNumVoices, uint64_t newTailFrames)
+{
+	numVoices = std::min(newNumVoices, kMaxVoices);
+	tailFrames = newTailFrames;
+	reset();
+}
+
+void VoiceAllocator::reset()
+{
+	for(Voice& v : voices)
+		v = { -1, false, 0, 0 };
+	serial = 0;
+	asleepFrame = 0;
+	steals = 0;
+}
+
+bool VoiceAllocator::isActive(const Voice& v, uint64_t frame) const
+{
+	return v.held || (v.key >= 0 && frame < v.frame + tailFrames);
+}
+
+void VoiceAllocator::update(unsigned int voice, int key, bool held, uint64_t frame)
+{
+	voices[voice] = { key, held, serial++, frame };
+	asleepFrame = 0;
+	for(unsigned int n = 0; n < numVoices; ++n) {
+		const Voice& v = voices[n];
+		if(v.held)
+			asleepFrame = UINT64_MAX;
+		else if(v.key >= 0)
+			asleepFrame = std::max(asleepFrame, v.frame + tailFrames);
+	}
+}
+
+int VoiceAllocator::noteOn(int key, uint64_t frame, int* stolenKey)
+{
+	if(stolenKey)
+		*stolenKey = -1;
+	// the free voice released the longest ago, else the oldest held one
+	int freeVoice = -1;
+	int heldVoice = -1;
+	for(unsigned int n = 0; n < numVoices; ++n) {
+		const Voice& v = voices[n];
+		if(v.held) {
+			if(heldVoice < 0 || v.serial < voices[heldVoice].serial)
+				heldVoice = n;
+		} else if(freeVoice < 0 || v.serial < voices[freeVoice].serial) {
+			freeVoice = n;
+		}
+	}
+	int voice = freeVoice;
+	if(voice < 0) {
+		if(heldVoice < 0)
+			return -1;
+		voice = heldVoice;
+		if(stolenKey)
+			*stolenKey = voices[voice].key;
+		++steals;
+	}
+	update(voice, key, true, frame);
+	return voice;
+}
+
+int VoiceAllocator::noteOff(int key, uint64_t frame)
+{
+	int voice = -1;
+	for(unsigned int n = 0; n < numVoices; ++n) {
+		const Voice& v = voices[n];
+		if(v.held && v.key == key && (voice < 0 || v.serial < voices[voice].serial))
+			voice = n;
+	}
+	if(voice >= 0)
+		update(voice, key, false, frame);
+	return voice;
+}
+
+unsigned int VoiceAllocator::getNumActive(uint64_t frame) const
+{
+	unsigned int active = 0;
+	for(unsigned int n = 0; n < numVoices; ++n)
+		active += isActive(voices[n], frame);
+	return active;
+}
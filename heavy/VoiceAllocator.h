@@ -0,0 +1,67 @@
+/*
+ * VoiceAllocator
+ * --------------
+ * Keeps track of which voice of the patch plays which key, and for how much
+ * longer each voice can be heard.
+ *
+ * The voices themselves are in the Heavy context: keystatus goes through
+ * [poly 3 1] in _main.pd to the three instances of filters~. noteOn() and
+ * noteOff() make the same choices as poly does, so the voice they return is
+ * the one the patch picks: a free voice if there is one, the one released
+ * the longest ago first, otherwise the voice that has been playing the
+ * longest. That is the only policy poly has, and the patch picks its voices
+ * itself, so it is the only one followed here.
+ *
+ * A voice is active while its key is held and for tailFrames after it is
+ * released, long enough for its envelopes and delay lines to die out. Once
+ * no voice is active, the patch only plays what comes in from the
+ * microphone (see the idle bypass in render.cpp).
+ */
+
+#ifndef VOICEALLOCATOR_H_
+#define VOICEALLOCATOR_H_
+
+#include <stdint.h>
+
+class VoiceAllocator {
+public:
+	static constexpr unsigned int kMaxVoices = 16;
+
+	struct Voice {
+		int key; // -1 until the voice first plays
+		bool held;
+		uint32_t serial; // order of the last note on or off, as in poly
+		uint64_t frame; // of the last note on or off
+	};
+
+	VoiceAllocator();
+
+	void setup(unsigned int numVoices, uint64_t tailFrames);
+	void reset();
+
+	// Returns the voice that plays key, or -1 when there are no voices. If
+	// a held voice was stolen, its key is written to stolenKey, otherwise -1.
+	int noteOn(int key, uint64_t frame, int* stolenKey = nullptr);
+	// Returns the voice that key was released on, or -1 if it was not playing
+	int noteOff(int key, uint64_t frame);
+
+	unsigned int getNumActive(uint64_t frame) const;
+	bool isAsleep(uint64_t frame) const { return frame >= asleepFrame; }
+
+	unsigned int getNumVoices() const { return numVoices; }
+	const Voice& getVoice(unsigned int voice) const { return voices[voice]; }
+	uint64_t getSteals() const { return steals; }
+
+private:
+	bool isActive(const Voice& v, uint64_t frame) const;
+	void update(unsigned int voice, int key, bool held, uint64_t frame);
+
+	Voice voices[kMaxVoices];
+	unsigned int numVoices;
+	uint64_t tailFrames;
+	uint32_t serial;
+	uint64_t asleepFrame; // first frame at which no voice is active
+	uint64_t steals;
+};
+
+#endif // VOICEALLOCATOR_H_
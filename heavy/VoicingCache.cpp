@@ -0,0 +1,96 @@
+#include "VoicingCache.h"
+#include "TableBlob.h"
+#include <Heavy_bela.h>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+const char* const VoicingCache::tableNames[kNumTables] = {
+	"t-R1_f", "t-R1_q", "t-R1_g",
+	"t-R2_f", "t-R2_q", "t-R2_g",
+	"t-P1_f", "t-P1_q", "t-P1_g",
+	"t-Tps",
+	"f-F_f", "f-Q_f", "f-F_sw", "f-T_f",
+};
+
+bool VoicingCache::build(const TableBlob& blob, float sampleRate)
+{
+	const float* tables[kNumTables] = {};
+	unsigned int lengths[kNumTables] = {};
+	for(unsigned int t = 0; t < blob.getNumTables(); ++t) {
+		for(unsigned int n = 0; n < kNumTables; ++n) {
+			if(!strcmp(blob.getEntry(t).name, tableNames[n])) {
+				tables[n] = blob.getValues(t);
+				lengths[n] = blob.getEntry(t).length;
+			}
+		}
+	}
+	return build(tables, lengths, sampleRate);
+}
+
+bool VoicingCache::build(HeavyContextInterface* context, float sampleRate)
+{
+	const float* tables[kNumTables];
+	unsigned int lengths[kNumTables];
+	for(unsigned int n = 0; n < kNumTables; ++n) {
+		const hv_uint32_t hash = hv_stringToHash(tableNames[n]);
+		tables[n] = hv_table_getBuffer(context, hash);
+		lengths[n] = tables[n] ? hv_table_getLength(context, hash) : 0;
+	}
+	return build(tables, lengths, sampleRate);
+}
+
+bool VoicingCache::build(const float* const* tables, const unsigned int* lengths, float sampleRate)
+{
+	unsigned int numKeys = ~0u;
+	unsigned int numKats = ~0u;
+	for(unsigned int n = 0; n < kNumTables; ++n) {
+		if(!tables[n] || !lengths[n]) {
+			fprintf(stderr, "Error: no table %s to build the voicings from\n", tableNames[n]);
+			return false;
+		}
+		if(n < kKatFreq)
+			numKeys = std::min(numKeys, lengths[n]);
+		else
+			numKats = std::min(numKats, lengths[n]);
+	}
+
+	Set& set = sets[!active.load(std::memory_order_acquire)];
+	set.voicings.resize(numKeys * numKats);
+	for(unsigned int kat = 0; kat < numKats; ++kat) {
+		const float katFreq = tables[kKatFreq][kat];
+		const float katQ = tables[kKatQ][kat];
+		const bool swap = tables[kKatSwap][kat] != 0;
+		for(unsigned int key = 0; key < numKeys; ++key) {
+			Voicing& v = set.voicings[kat * numKeys + key];
+			for(unsigned int s = 0; s < kNumStages; ++s) {
+				v.stages[s].freq = tables[kR1Freq + 3 * s][key] * katFreq;
+				v.stages[s].q = tables[kR1Q + 3 * s][key] * katQ;
+				v.stages[s].gain = tables[kR1Gain + 3 * s][key];
+			}
+			// F_swap trades the resonator frequencies, after the scaling
+			if(swap)
+				std::swap(v.stages[kR1].freq, v.stages[kR2].freq);
+			for(unsigned int s = kR1; s <= kR2; ++s)
+				v.stages[s].coefficients = FilterBank::resonator(sampleRate, v.stages[s].freq, v.stages[s].q, 1);
+			v.stages[kP1].coefficients = FilterBank::peak(sampleRate, v.stages[kP1].freq, v.stages[kP1].q,
+					v.stages[kP1].gain);
+
+			v.transposition = tables[kTranspose][key] * tables[kKatTranspose][kat];
+			const float x = v.transposition;
+			v.transposeRampMs = x == 1 ? 0 : 1500 * x / (x - 1);
+		}
+	}
+	set.numKeys = numKeys;
+	set.numKats = numKats;
+	active.store(&set - sets, std::memory_order_release);
+	return true;
+}
+
+const VoicingCache::Voicing* VoicingCache::lookup(unsigned int key, unsigned int kat) const
+{
+	const Set& set = sets[active.load(std::memory_order_acquire)];
+	if(key >= set.numKeys || kat >= set.numKats)
+		return nullptr;
+	return &set.voicings[kat * set.numKeys + key];
+}
@@ -0,0 +1,91 @@
+/*
+ * VoicingCache
+ * ------------
+ * What the voicing tables make of every key, worked out once when the
+ * tables are loaded rather than inside the voice.
+ *
+ * When a voice is given a key, the envelopes subpatch of filters~ reads the
+ * t-* tables at the key and scales them by the f-* tables at the voice's
+ * category (kat, from t-Kat): R1_f and R2_f by F_f, swapped when F_sw is
+ * set, the q's by Q_f and P1_f by F_f. It then ramps the resonators' gain
+ * and q and the peak filter's gain towards those values, and resonparams
+ * and peakparams turn them into coefficients with cos, exp, sqrt and pow
+ * on every sample. transposeramp reads t-Tps and T_f the same way.
+ *
+ * build() does all of that for every key and category up front: the
+ * frequency, q and gain of each stage, its biquad coefficients (the
+ * resonators at unit gain, their gain applied by the envelope; the peak
+ * filter at its full gain) and the transposition. lookup() is then a
+ * couple of index operations.
+ *
+ * build() runs off the audio thread. It fills the set that is not in use
+ * and publishes it with one atomic store, so lookup() on the audio thread
+ * never sees a half built set, as long as builds come at least a block
+ * apart.
+ */
+
+#ifndef VOICINGCACHE_H_
+#define VOICINGCACHE_H_
+
+#include "FilterBank.h"
+#include <atomic>
+#include <vector>
+
+class HeavyContextInterface;
+class TableBlob;
+
+class VoicingCache {
+public:
+	enum Stage {
+		kR1,
+		kR2,
+		kP1,
+		kNumStages
+	};
+
+	struct Voicing {
+		struct {
+			float freq;
+			float q;
+			float gain;
+			FilterBank::Coefficients coefficients;
+		} stages[kNumStages];
+		float transposition; // t-Tps * T_f, 1 when the key is not transposed
+		float transposeRampMs; // how long transposeramp takes over its 1500 ms delay, 0 for none
+	};
+
+	// Non-real-time. Reads the tables from the blob, or those the patch has
+	// now, and returns false if any is missing.
+	bool build(const TableBlob& blob, float sampleRate);
+	bool build(HeavyContextInterface* context, float sampleRate);
+
+	// nullptr for a key or category the tables do not cover
+	const Voicing* lookup(unsigned int key, unsigned int kat) const;
+
+	unsigned int getNumKeys() const { return sets[active.load(std::memory_order_acquire)].numKeys; }
+	unsigned int getNumKats() const { return sets[active.load(std::memory_order_acquire)].numKats; }
+
+private:
+	enum Table {
+		kR1Freq, kR1Q, kR1Gain,
+		kR2Freq, kR2Q, kR2Gain,
+		kP1Freq, kP1Q, kP1Gain,
+		kTranspose,
+		kKatFreq, kKatQ, kKatSwap, kKatTranspose,
+		kNumTables
+	};
+	static const char* const tableNames[kNumTables];
+
+	struct Set {
+		std::vector<Voicing> voicings; // numKeys voicings for each kat
+		unsigned int numKeys = 0;
+		unsigned int numKats = 0;
+	};
+
+	bool build(const float* const* tables, const unsigned int* lengths, float sampleRate);
+
+	Set sets[2];
+	std::atomic<unsigned int> active { 0 };
+};
+
+#endif // VOICINGCACHE_H_
@@ -0,0 +1,80 @@
+/*
+ * Host stand-in for the Bela auxiliary tasks: one thread per task, woken by
+ * Bela_scheduleAuxiliaryTask(). Scheduling takes a mutex, which the board
+ * does not, so the bench numbers include a little more than render() would
+ * spend on Bela when a task is scheduled.
+ */
+
+#include <Bela.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct HostAuxiliaryTask {
+	void (*callback)(void*);
+	void* arg;
+	std::string name;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool scheduled = false;
+	bool stop = false;
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while(true) {
+			wake.wait(lock, [this] { return scheduled || stop; });
+			if(stop)
+				return;
+			scheduled = false;
+			lock.unlock();
+			callback(arg);
+			lock.lock();
+		}
+	}
+};
+
+std::vector<HostAuxiliaryTask*> gTasks;
+
+} // namespace
+
+AuxiliaryTask Bela_createAuxiliaryTask(void (*callback)(void*), int priority, const char *name, void* arg)
+{
+	HostAuxiliaryTask* task = new HostAuxiliaryTask;
+	task->callback = callback;
+	task->arg = arg;
+	task->name = name;
+	task->thread = std::thread(&HostAuxiliaryTask::run, task);
+	gTasks.push_back(task);
+	return task;
+}
+
+int Bela_scheduleAuxiliaryTask(AuxiliaryTask task)
+{
+	HostAuxiliaryTask* t = (HostAuxiliaryTask*)task;
+	{
+		std::lock_guard<std::mutex> lock(t->mutex);
+		t->scheduled = true;
+	}
+	t->wake.notify_one();
+	return 0;
+}
+
+void Bela_deleteAllAuxiliaryTasks()
+{
+	for(auto task : gTasks) {
+		{
+			std::lock_guard<std::mutex> lock(task->mutex);
+			task->stop = true;
+		}
+		task->wake.notify_one();
+		task->thread.join();
+		delete task;
+	}
+	gTasks.clear();
+}
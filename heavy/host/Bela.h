@@ -0,0 +1,122 @@
+/*
+ * Host stand-in for Bela.h
+ * ------------------------
+ * Just enough of the Bela core API for render.cpp to build and run on an
+ * ordinary Linux machine. The buffer layout and the inline accessors follow
+ * the real Bela.h (interleaved audio and analog, digital words with the pin
+ * directions in the low 16 bits and the pin values in the high 16 bits), so
+ * render.cpp sees exactly the data it would see on the board.
+ *
+ * This header is only on the include path of the host build (see Makefile),
+ * it is never used when building on Bela.
+ */
+
+#ifndef BELA_HOST_H_
+#define BELA_HOST_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+
+#define MAX_PROJECTNAME_LENGTH 256
+
+#define rt_printf printf
+#define rt_fprintf fprintf
+
+typedef struct {
+	const float * audioIn;
+	float * audioOut;
+	const float * analogIn;
+	float * analogOut;
+	uint32_t * digital;
+
+	uint32_t audioFrames;
+	uint32_t audioInChannels;
+	uint32_t audioOutChannels;
+	float audioSampleRate;
+
+	uint32_t analogFrames;
+	uint32_t analogInChannels;
+	uint32_t analogOutChannels;
+	float analogSampleRate;
+
+	uint32_t digitalFrames;
+	uint32_t digitalChannels;
+	float digitalSampleRate;
+
+	uint64_t audioFramesElapsed;
+
+	uint32_t multiplexerChannels;
+	uint32_t multiplexerStartingChannel;
+	const float * multiplexerAnalogIn;
+
+	uint32_t audioExpanderEnabled;
+	uint32_t flags;
+	char projectName[MAX_PROJECTNAME_LENGTH];
+} BelaContext;
+
+// User-defined functions, implemented in render.cpp
+bool setup(BelaContext *context, void *userData);
+void render(BelaContext *context, void *userData);
+void cleanup(BelaContext *context, void *userData);
+
+static inline float audioRead(BelaContext *context, int frame, int channel) {
+	return context->audioIn[frame * context->audioInChannels + channel];
+}
+
+static inline void audioWrite(BelaContext *context, int frame, int channel, float value) {
+	context->audioOut[frame * context->audioOutChannels + channel] = value;
+}
+
+static inline float analogRead(BelaContext *context, int frame, int channel) {
+	return context->analogIn[frame * context->analogInChannels + channel];
+}
+
+static inline void analogWriteOnce(BelaContext *context, int frame, int channel, float value) {
+	context->analogOut[frame * context->analogOutChannels + channel] = value;
+}
+
+static inline void analogWrite(BelaContext *context, int frame, int channel, float value) {
+	for(unsigned int f = frame; f < context->analogFrames; f++)
+		analogWriteOnce(context, f, channel, value);
+}
+
+static inline int digitalRead(BelaContext *context, int frame, int channel) {
+	return (context->digital[frame] >> (channel + 16)) & 1;
+}
+
+static inline void digitalWriteOnce(BelaContext *context, int frame, int channel, int value) {
+	if(value)
+		context->digital[frame] |= 1 << (channel + 16);
+	else
+		context->digital[frame] &= ~(1 << (channel + 16));
+}
+
+static inline void digitalWrite(BelaContext *context, int frame, int channel, int value) {
+	for(unsigned int f = frame; f < context->digitalFrames; f++)
+		digitalWriteOnce(context, f, channel, value);
+}
+
+static inline void pinMode(BelaContext *context, int frame, int channel, int mode) {
+	for(unsigned int f = frame; f < context->digitalFrames; f++) {
+		if(mode == INPUT)
+			context->digital[f] |= (1 << channel);
+		else
+			context->digital[f] &= ~(1 << channel);
+	}
+}
+
+// Auxiliary tasks run on their own thread, see AuxiliaryTask.cpp. On the
+// host a scheduled task runs once, as soon as its thread is free.
+#define BELA_AUDIO_PRIORITY 95
+
+typedef void* AuxiliaryTask;
+
+AuxiliaryTask Bela_createAuxiliaryTask(void (*callback)(void*), int priority, const char *name, void* arg = NULL);
+int Bela_scheduleAuxiliaryTask(AuxiliaryTask task);
+// Waits for running tasks to return and deletes them all
+void Bela_deleteAllAuxiliaryTasks();
+
+#endif // BELA_HOST_H_
@@ -0,0 +1,112 @@
+/*
+ * Host stand-in for Bela's DigitalChannelManager
+ * ----------------------------------------------
+ * Same interface and message-rate semantics as the Bela core class, written
+ * header-only so the host build does not need the Bela sources.
+ */
+
+#ifndef DIGITALCHANNELMANAGER_HOST_H_
+#define DIGITALCHANNELMANAGER_HOST_H_
+
+#include <Bela.h>
+
+class DigitalChannelManager {
+public:
+	DigitalChannelManager() :
+		callback(nullptr),
+		inputs(0), outputs(0), messageRate(0),
+		managed(0), setDataOut(0), clearDataOut(0), lastDigitalValues(0)
+	{
+		for(unsigned int n = 0; n < kNumChannels; ++n)
+			callbackArguments[n] = nullptr;
+	}
+
+	void setCallback(void (*newCallback)(bool, unsigned int, void*)) {
+		callback = newCallback;
+	}
+
+	void setCallbackArgument(unsigned int channel, void* arg) {
+		if(channel < kNumChannels)
+			callbackArguments[channel] = arg;
+	}
+
+	void processInput(uint32_t* digitals, unsigned int length) {
+		if(callback == nullptr)
+			return;
+		uint32_t messageRateInputs = inputs & messageRate & managed;
+		for(unsigned int frame = 0; frame < length; ++frame) {
+			uint32_t values = digitals[frame] >> 16;
+			uint32_t changed = (values ^ lastDigitalValues) & messageRateInputs;
+			for(unsigned int channel = 0; changed; ++channel, changed >>= 1) {
+				if(changed & 1)
+					callback((values >> channel) & 1, frame, callbackArguments[channel]);
+			}
+			lastDigitalValues = values;
+		}
+	}
+
+	void processOutput(uint32_t* digitals, unsigned int length) {
+		for(unsigned int frame = 0; frame < length; ++frame) {
+			digitals[frame] = (digitals[frame] & ~(clearDataOut << 16)) | (setDataOut << 16);
+			digitals[frame] = (digitals[frame] & ~managed) | (inputs & managed);
+		}
+	}
+
+	void setValue(unsigned int channel, bool value) {
+		if(channel >= kNumChannels || !isOutput(channel) || !isMessageRate(channel))
+			return;
+		if(value) {
+			setDataOut |= 1 << channel;
+			clearDataOut &= ~(1 << channel);
+		} else {
+			setDataOut &= ~(1 << channel);
+			clearDataOut |= 1 << channel;
+		}
+	}
+
+	void manage(unsigned int channel, bool direction, bool isMessageRate) {
+		if(channel >= kNumChannels)
+			return;
+		uint32_t bit = 1 << channel;
+		managed |= bit;
+		if(direction == INPUT) {
+			inputs |= bit;
+			outputs &= ~bit;
+		} else {
+			outputs |= bit;
+			inputs &= ~bit;
+		}
+		if(isMessageRate)
+			messageRate |= bit;
+		else
+			messageRate &= ~bit;
+	}
+
+	void unmanage(unsigned int channel) {
+		if(channel >= kNumChannels)
+			return;
+		uint32_t bit = 1 << channel;
+		managed &= ~bit;
+		setDataOut &= ~bit;
+		clearDataOut &= ~bit;
+	}
+
+	bool isSignalRate(unsigned int channel) { return !isMessageRate(channel); }
+	bool isMessageRate(unsigned int channel) { return (messageRate >> channel) & 1; }
+	bool isInput(unsigned int channel) { return (inputs >> channel) & 1; }
+	bool isOutput(unsigned int channel) { return (outputs >> channel) & 1; }
+
+private:
+	static constexpr unsigned int kNumChannels = 16;
+	void (*callback)(bool, unsigned int, void*);
+	void* callbackArguments[kNumChannels];
+	uint32_t inputs;
+	uint32_t outputs;
+	uint32_t messageRate;
+	uint32_t managed;
+	uint32_t setDataOut;
+	uint32_t clearDataOut;
+	uint32_t lastDigitalValues;
+};
+
+#endif // DIGITALCHANNELMANAGER_HOST_H_
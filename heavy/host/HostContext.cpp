@@ -0,0 +1,80 @@
+#include "HostContext.h"
+#include <algorithm>
+#include <string.h>
+
+HostContext::HostContext(const HostConfig& config) :
+	noiseState(22222),
+	noiseScale(config.inputLevel / 8388608.f)
+{
+	memset(&context, 0, sizeof(context));
+	unsigned int analogFrames = config.analogChannels > 4 ? config.audioFrames / 2 : config.audioFrames;
+
+	context.audioFrames = config.audioFrames;
+	context.audioInChannels = config.audioChannels;
+	context.audioOutChannels = config.audioChannels;
+	context.audioSampleRate = config.sampleRate;
+
+	context.analogFrames = config.analogChannels ? analogFrames : 0;
+	context.analogInChannels = config.analogChannels;
+	context.analogOutChannels = config.analogChannels;
+	context.analogSampleRate = config.analogChannels ?
+		config.sampleRate * analogFrames / config.audioFrames : 0;
+
+	context.digitalFrames = config.digitalChannels ? config.audioFrames : 0;
+	context.digitalChannels = config.digitalChannels;
+	context.digitalSampleRate = config.digitalChannels ? config.sampleRate : 0;
+
+	context.multiplexerChannels = config.analogChannels ? config.multiplexerChannels : 0;
+
+	audioIn.assign(context.audioFrames * context.audioInChannels, 0.f);
+	audioOut.assign(context.audioFrames * context.audioOutChannels, 0.f);
+	analogIn.assign(context.analogFrames * context.analogInChannels, 0.f);
+	analogOut.assign(context.analogFrames * context.analogOutChannels, 0.f);
+	digital.assign(context.digitalFrames, 0);
+	multiplexerIn.assign(context.multiplexerChannels * context.analogInChannels, 0.f);
+
+	context.audioIn = audioIn.data();
+	context.audioOut = audioOut.data();
+	context.analogIn = analogIn.data();
+	context.analogOut = analogOut.data();
+	context.digital = digital.data();
+	context.multiplexerAnalogIn = multiplexerIn.data();
+	strncpy(context.projectName, "heavy", MAX_PROJECTNAME_LENGTH - 1);
+}
+
+void HostContext::fillAudioInput()
+{
+	for(auto& sample : audioIn) {
+		noiseState = noiseState * 1664525u + 1013904223u;
+		sample = ((int32_t)noiseState >> 8) * noiseScale;
+	}
+}
+
+void HostContext::scanMultiplexer()
+{
+	if(!context.multiplexerChannels)
+		return;
+	for(unsigned int n = 0; n < context.analogFrames; ++n) {
+		const unsigned int channel = (context.multiplexerStartingChannel + n) % context.multiplexerChannels;
+		std::copy_n(&analogIn[n * context.analogInChannels], context.analogInChannels,
+				&multiplexerIn[channel * context.analogInChannels]);
+	}
+}
+
+void HostContext::advance()
+{
+	context.audioFramesElapsed += context.audioFrames;
+	if(context.multiplexerChannels)
+		context.multiplexerStartingChannel = (context.multiplexerStartingChannel + context.analogFrames)
+				% context.multiplexerChannels;
+}
+
+unsigned int HostContext::getAudioFramesPerAnalogFrame() const
+{
+	return context.analogFrames ? context.audioFrames / context.analogFrames : 0;
+}
+
+double HostContext::getBlockPeriodNs() const
+{
+	return 1e9 * context.audioFrames / context.audioSampleRate;
+}
@@ -0,0 +1,59 @@
+/*
+ * HostContext
+ * -----------
+ * Owns the buffers behind a stand-in BelaContext and lays them out the way
+ * the Bela core does for a given block size, sample rate and analog channel
+ * count. The analog rate follows the board: with 8 analog channels the analog
+ * inputs run at half the audio rate, with 4 or fewer at the audio rate.
+ */
+
+#ifndef HOSTCONTEXT_H_
+#define HOSTCONTEXT_H_
+
+#include <Bela.h>
+#include <vector>
+
+struct HostConfig {
+	unsigned int audioFrames = 16;
+	float sampleRate = 44100;
+	unsigned int audioChannels = 2;
+	unsigned int analogChannels = 8;
+	unsigned int digitalChannels = 16;
+	unsigned int multiplexerChannels = 0;
+	float inputLevel = 0.01f; // peak of the noise on the audio inputs
+};
+
+class HostContext {
+public:
+	explicit HostContext(const HostConfig& config);
+
+	BelaContext* get() { return &context; }
+	// The context only exposes the inputs as const, the harness writes them here.
+	float* getAnalogIn() { return analogIn.data(); }
+
+	// Fill the audio inputs with deterministic noise at config.inputLevel, so
+	// that the patch sees the same input on every run.
+	void fillAudioInput();
+	// Copy the analog inputs of this block into the multiplexer channels
+	// they were read from, as the Bela core does, once they are filled in.
+	void scanMultiplexer();
+	// Move the frame counter, and the multiplexer channel the next block
+	// starts on, on by one block, to be called after render().
+	void advance();
+
+	unsigned int getAudioFramesPerAnalogFrame() const;
+	double getBlockPeriodNs() const;
+
+private:
+	BelaContext context;
+	std::vector<float> audioIn;
+	std::vector<float> audioOut;
+	std::vector<float> analogIn;
+	std::vector<float> analogOut;
+	std::vector<uint32_t> digital;
+	std::vector<float> multiplexerIn;
+	uint32_t noiseState;
+	float noiseScale;
+};
+
+#endif // HOSTCONTEXT_H_
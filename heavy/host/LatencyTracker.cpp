@@ -0,0 +1,102 @@
+#include "LatencyTracker.h"
+#include <algorithm>
+#include <cmath>
+
+LatencyTracker* LatencyTracker::active = nullptr;
+
+LatencyTracker::LatencyTracker() :
+	keyHash(hv_stringToHash("keystatus")),
+	xkeyHash(hv_stringToHash("xkeystatus")),
+	hitHash(hv_stringToHash("nedslag1")),
+	dueFrame(0)
+{}
+
+void LatencyTracker::beginBlock(uint64_t startFrame, unsigned int frames)
+{
+	// render() schedules its events after hv_processInline(), so their delays
+	// count from the start of the next block
+	dueFrame = startFrame + frames;
+}
+
+std::deque<uint64_t>* LatencyTracker::pendingFor(SensorScript::EventType type, unsigned int index)
+{
+	switch(type) {
+		case SensorScript::kKey:
+			return index < SensorScript::kNumKeys ? &pendingKeys[index] : nullptr;
+		case SensorScript::kXKey:
+			return index < SensorScript::kNumXKeys ? &pendingXKeys[index] : nullptr;
+		case SensorScript::kHit:
+			return &pendingHits;
+	}
+	return nullptr;
+}
+
+void LatencyTracker::onScriptEvent(const SensorScript::Event& event, uint64_t frame)
+{
+	if(event.type != SensorScript::kHit && !event.value)
+		return;
+	std::deque<uint64_t>* pending = pendingFor(event.type, event.index);
+	if(pending)
+		pending->push_back(frame);
+}
+
+void LatencyTracker::onMessage(hv_uint32_t receiverHash, uint64_t timestamp, const HvMessage* m)
+{
+	std::deque<uint64_t>* pending = nullptr;
+	if(receiverHash == hitHash) {
+		pending = &pendingHits;
+	} else if(receiverHash == keyHash || receiverHash == xkeyHash) {
+		if(!hv_msg_isFloat(m, 0) || !hv_msg_isFloat(m, 1) || hv_msg_getFloat(m, 1) == 0.0f)
+			return;
+		pending = pendingFor(receiverHash == keyHash ? SensorScript::kKey : SensorScript::kXKey,
+				(unsigned int) hv_msg_getFloat(m, 0));
+	}
+	if(!pending || pending->empty())
+		return;
+	// a bounce or a repeated hit inside the debounce time is reported only
+	// once, so drop everything that this event covers
+	uint64_t frame = pending->front();
+	while(!pending->empty() && pending->front() <= timestamp)
+		pending->pop_front();
+	if(timestamp >= frame)
+		latencies.push_back(timestamp - frame);
+}
+
+LatencyTracker::Stats LatencyTracker::getStats() const
+{
+	Stats stats = {};
+	for(auto& p : pendingKeys)
+		stats.unmatched += p.size();
+	for(auto& p : pendingXKeys)
+		stats.unmatched += p.size();
+	stats.unmatched += pendingHits.size();
+	stats.events = latencies.size();
+	if(latencies.empty())
+		return stats;
+	double sum = 0;
+	double sumSquares = 0;
+	for(auto l : latencies) {
+		sum += l;
+		sumSquares += (double) l * l;
+	}
+	stats.meanSamples = sum / latencies.size();
+	stats.minSamples = *std::min_element(latencies.begin(), latencies.end());
+	stats.maxSamples = *std::max_element(latencies.begin(), latencies.end());
+	stats.jitterSamples = std::sqrt(std::max(0.0, sumSquares / latencies.size() - stats.meanSamples * stats.meanSamples));
+	return stats;
+}
+
+// Stands in for hv_sendMessageToReceiver() in the bench, see Makefile
+extern "C" bool __real_hv_sendMessageToReceiver(HeavyContextInterface *c, hv_uint32_t receiverHash, double delayMs, HvMessage *m);
+extern "C" bool __wrap_hv_sendMessageToReceiver(HeavyContextInterface *c, hv_uint32_t receiverHash, double delayMs, HvMessage *m)
+{
+	if(LatencyTracker::active) {
+		// same conversion as HeavyContext::sendMessageToReceiver(), but from the
+		// host's frame count: hv_getCurrentSample() falls behind it whenever
+		// the idle bypass skips Heavy
+		uint64_t timestamp = LatencyTracker::active->getDueFrame()
+				+ (hv_uint32_t) (delayMs * (hv_getSampleRate(c) / 1000.0));
+		LatencyTracker::active->onMessage(receiverHash, timestamp, m);
+	}
+	return __real_hv_sendMessageToReceiver(c, receiverHash, delayMs, m);
+}
@@ -0,0 +1,61 @@
+/*
+ * LatencyTracker
+ * --------------
+ * Matches the key presses, X-key presses and hits of a SensorScript with the
+ * keystatus, xkeystatus and nedslag1 messages that render() schedules into
+ * Heavy, and collects the delay between the two in samples: the time from the
+ * sensor changing at the input to the event being due inside the patch.
+ * Releases are left out, they are delayed by the debounce on purpose.
+ *
+ * The host build links the bench with --wrap=hv_sendMessageToReceiver, so
+ * every message render() sends passes through onMessage() first. Messages
+ * are timestamped from the host's frame count rather than from Heavy's clock,
+ * which stands still while the idle bypass skips Heavy.
+ */
+
+#ifndef LATENCYTRACKER_H_
+#define LATENCYTRACKER_H_
+
+#include "SensorScript.h"
+#include <HvHeavy.h>
+#include <deque>
+#include <vector>
+
+class LatencyTracker {
+public:
+	struct Stats {
+		unsigned long long events;
+		unsigned long long unmatched; // presses that never reached the patch
+		double meanSamples;
+		double minSamples;
+		double maxSamples;
+		double jitterSamples; // standard deviation
+	};
+
+	LatencyTracker();
+
+	// Call before each render() with the host's audioFramesElapsed
+	void beginBlock(uint64_t startFrame, unsigned int frames);
+	void onScriptEvent(const SensorScript::Event& event, uint64_t frame);
+	void onMessage(hv_uint32_t receiverHash, uint64_t timestamp, const HvMessage* m);
+
+	Stats getStats() const;
+	uint64_t getDueFrame() const { return dueFrame; }
+
+	// The tracker that the wrapped hv_sendMessageToReceiver() reports to.
+	static LatencyTracker* active;
+
+private:
+	std::deque<uint64_t>* pendingFor(SensorScript::EventType type, unsigned int index);
+
+	hv_uint32_t keyHash;
+	hv_uint32_t xkeyHash;
+	hv_uint32_t hitHash;
+	uint64_t dueFrame; // the frame Heavy's next block starts on
+	std::deque<uint64_t> pendingKeys[SensorScript::kNumKeys];
+	std::deque<uint64_t> pendingXKeys[SensorScript::kNumXKeys];
+	std::deque<uint64_t> pendingHits;
+	std::vector<uint32_t> latencies;
+};
+
+#endif // LATENCYTRACKER_H_
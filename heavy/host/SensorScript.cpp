@@ -0,0 +1,152 @@
+#include "SensorScript.h"
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+// from render.cpp
+extern bool gXSensorInverted[8];
+
+static const float kHitRest = 0.8f;
+static const float kHitDown = 0.05f;
+static const float kDefaultHitMs = 3;
+
+SensorScript::SensorScript() :
+	lengthMs(0),
+	passStartMs(0),
+	nextEvent(0),
+	keys(0),
+	xkeys(0),
+	hitStartMs(0),
+	hitEndMs(-std::numeric_limits<double>::infinity()),
+	hitFallMs(0)
+{}
+
+bool SensorScript::load(const std::string& path)
+{
+	std::ifstream file(path);
+	if(!file) {
+		fprintf(stderr, "Unable to open script %s\n", path.c_str());
+		return false;
+	}
+	events.clear();
+	double endMs = -1;
+	std::string line;
+	unsigned int lineNumber = 0;
+	while(std::getline(file, line)) {
+		++lineNumber;
+		line = line.substr(0, line.find('#'));
+		std::istringstream words(line);
+		double timeMs;
+		std::string type;
+		if(!(words >> timeMs))
+			continue; // blank or comment
+		bool ok = bool(words >> type);
+		Event e = { timeMs, kKey, 0, 1, 0 };
+		if(ok && type == "key") {
+			ok = (words >> e.index >> e.value) && e.index < kNumKeys;
+		} else if(ok && type == "xkey") {
+			e.type = kXKey;
+			ok = (words >> e.index >> e.value) && e.index < kNumXKeys;
+		} else if(ok && type == "hit") {
+			e.type = kHit;
+			if(!(words >> e.value))
+				e.value = kDefaultHitMs;
+			else if(!(words >> e.fallMs))
+				e.fallMs = 0;
+		} else if(ok && type == "end") {
+			endMs = timeMs;
+			continue;
+		} else {
+			ok = false;
+		}
+		if(!ok) {
+			fprintf(stderr, "%s:%u: cannot parse \"%s\"\n", path.c_str(), lineNumber, line.c_str());
+			return false;
+		}
+		events.push_back(e);
+	}
+	std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+		return a.timeMs < b.timeMs;
+	});
+	if(endMs > 0)
+		lengthMs = endMs;
+	else
+		lengthMs = events.empty() ? 0 : events.back().timeMs + 100;
+	return true;
+}
+
+void SensorScript::advanceTo(double timeMs, uint64_t frame)
+{
+	if(events.empty() || lengthMs <= 0)
+		return;
+	while(timeMs >= passStartMs + lengthMs) {
+		passStartMs += lengthMs;
+		nextEvent = 0;
+		keys = 0;
+		xkeys = 0;
+		hitEndMs = -std::numeric_limits<double>::infinity();
+	}
+	double passTimeMs = timeMs - passStartMs;
+	while(nextEvent < events.size() && events[nextEvent].timeMs <= passTimeMs) {
+		const Event& e = events[nextEvent++];
+		if(listener)
+			listener(e, frame);
+		switch(e.type) {
+			case kKey:
+				if(e.value)
+					keys |= 1ull << e.index;
+				else
+					keys &= ~(1ull << e.index);
+				break;
+			case kXKey:
+				if(e.value)
+					xkeys |= 1 << e.index;
+				else
+					xkeys &= ~(1 << e.index);
+				break;
+			case kHit:
+				hitStartMs = passStartMs + e.timeMs;
+				hitEndMs = hitStartMs + e.value;
+				hitFallMs = e.fallMs;
+				break;
+		}
+	}
+}
+
+void SensorScript::apply(HostContext& host)
+{
+	BelaContext* context = host.get();
+	unsigned int audioFramesPerAnalogFrame = host.getAudioFramesPerAnalogFrame();
+	float* analogIn = host.getAnalogIn();
+	const double msPerFrame = 1000.0 / context->audioSampleRate;
+
+	for(unsigned int n = 0; n < context->audioFrames; ++n) {
+		uint64_t frame = context->audioFramesElapsed + n;
+		advanceTo(frame * msPerFrame, frame);
+
+		if(n < context->digitalFrames) {
+			unsigned int address = (digitalRead(context, n, 0) << 2)
+				| (digitalRead(context, n, 1) << 1)
+				| digitalRead(context, n, 2);
+			for(unsigned int m = 0; m < 6; ++m) {
+				unsigned int key = m * 8 + address;
+				bool pressed = key < kNumKeys && ((keys >> key) & 1);
+				digitalWriteOnce(context, n, m + 3, !pressed);
+			}
+			bool xPressed = (xkeys >> address) & 1;
+			digitalWriteOnce(context, n, 15, gXSensorInverted[address] ? xPressed : !xPressed);
+		}
+
+		if(audioFramesPerAnalogFrame && n % audioFramesPerAnalogFrame == 0) {
+			unsigned int analogFrame = n / audioFramesPerAnalogFrame;
+			const double timeMs = frame * msPerFrame;
+			float value = kHitRest;
+			if(timeMs < hitEndMs) {
+				double fall = hitFallMs > 0 ? std::min(1.0, (timeMs - hitStartMs) / hitFallMs) : 1;
+				value = kHitRest - (kHitRest - kHitDown) * fall;
+			}
+			analogIn[analogFrame * context->analogInChannels + kHitChannel] = value;
+		}
+	}
+}
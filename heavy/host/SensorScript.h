@@ -0,0 +1,91 @@
+/*
+ * SensorScript
+ * ------------
+ * Replays a scripted performance into the digital and analog inputs of a
+ * BelaContext, the way the typewriter hardware would present it to render():
+ *
+ * - key matrix: render() drives the row address on digital pins 0-2, and a
+ *   pressed key (m, n) pulls pin m + 3 low in the digital frames where the
+ *   address is n.
+ * - X-keys: pin 15 carries X-key n in the frames addressed n, active low
+ *   unless the key is listed in gXSensorInverted.
+ * - hit sensor: analog channel 0 rests at 0.8 and drops to 0.05 for the
+ *   duration of a hit.
+ *
+ * Script format, one event per line, '#' starts a comment:
+ *
+ *   <ms> key <0-43> <0|1>    key index is m * 8 + n, as sent to keystatus
+ *   <ms> xkey <0-7> <0|1>
+ *   <ms> hit [duration ms] [fall ms]
+ *                            default duration is 3 ms, the fall time (which
+ *                            sets the velocity) defaults to an instant drop
+ *   <ms> end                  loop length, defaults to last event + 100 ms
+ *
+ * The script loops for as long as it is applied, with all keys released at
+ * the start of each pass.
+ */
+
+#ifndef SENSORSCRIPT_H_
+#define SENSORSCRIPT_H_
+
+#include "HostContext.h"
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+class SensorScript {
+public:
+	enum EventType {
+		kKey,
+		kXKey,
+		kHit,
+	};
+
+	struct Event {
+		double timeMs;
+		EventType type;
+		unsigned int index;
+		float value; // 0/1 for keys, duration in ms for hits
+		float fallMs; // hits only
+	};
+
+	SensorScript();
+
+	// Returns false and prints the offending line if the file is malformed.
+	bool load(const std::string& path);
+
+	const std::vector<Event>& getEvents() const { return events; }
+	double getLengthMs() const { return lengthMs; }
+
+	// Set the sensor inputs of the current block. Uses the address lines
+	// that render() left in context->digital during the previous block.
+	void apply(HostContext& host);
+
+	// Called for every event as it reaches the inputs, with the audio frame
+	// (counted from the first block) it first appears in.
+	typedef std::function<void(const Event& event, uint64_t frame)> Listener;
+	void setListener(Listener listener) { this->listener = listener; }
+
+	static constexpr unsigned int kHitChannel = 0;
+	static constexpr unsigned int kNumKeys = 44;
+	static constexpr unsigned int kNumXKeys = 8;
+
+private:
+	void advanceTo(double timeMs, uint64_t frame);
+
+	std::vector<Event> events;
+	double lengthMs;
+
+	// playback state
+	double passStartMs;
+	size_t nextEvent;
+	uint64_t keys;
+	uint8_t xkeys;
+	double hitStartMs;
+	double hitEndMs;
+	double hitFallMs;
+	Listener listener;
+};
+
+#endif // SENSORSCRIPT_H_
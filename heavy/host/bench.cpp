@@ -0,0 +1,266 @@
+/*
+ * Offline benchmark for render.cpp
+ * --------------------------------
+ * Runs setup()/render()/cleanup() from render.cpp against a stand-in
+ * BelaContext on the host, replaying a scripted performance into the key
+ * matrix and hit sensor inputs, and reports the time spent in render() per
+ * block size. With -l it also reports the latency and jitter from a sensor
+ * change at the input to the event being due in the patch.
+ *
+ * Each block size runs in a child process, so the globals in render.cpp start
+ * from a clean state every time, as they would on the board.
+ *
+ * -W name records the events render() dispatches to name-<block>.tyev, -P
+ * plays a recording in place of the sensors, and -o name writes the audio
+ * output to name-<block>.raw (interleaved 32-bit floats), for comparing the
+ * output of two builds. -n sets the level of the noise on the audio inputs,
+ * 0 for a silent microphone.
+ *
+ * Usage: bench [-p 16,32,64] [-r 44100] [-C 8] [-X 0] [-n 0.01] [-d 10]
+ *              [-w 100] [-s script.txt] [-W name] [-P recording.tyev] [-o name] [-l] [-v]
+ */
+
+#include <Bela.h>
+#include "HostContext.h"
+#include "SensorScript.h"
+#include "LatencyTracker.h"
+#include <algorithm>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+struct BenchOptions {
+	std::vector<unsigned int> blockSizes = { 16, 32, 64, 128 };
+	HostConfig config;
+	double durationSec = 10;
+	unsigned int warmupBlocks = 100;
+	std::string scriptPath;
+	std::string recordName;
+	std::string replayPath;
+	std::string outputName;
+	std::string sizesPath;
+	bool latency = false;
+	bool verbose = false;
+};
+
+struct BenchResult {
+	bool ok;
+	unsigned int blockSize;
+	unsigned long long blocks;
+	double budgetNs;
+	double meanNs;
+	double p99Ns;
+	double worstNs;
+	LatencyTracker::Stats latency;
+};
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [-p blocksizes] [-r samplerate] [-C analogchannels] [-X multiplexerchannels]\n"
+		"       [-n inputlevel] [-d seconds] [-w warmupblocks] [-s script] [-W name] [-P recording] [-o name] [-z sizes] [-l] [-v]\n", name);
+}
+
+static bool parseOptions(int argc, char** argv, BenchOptions& options)
+{
+	int c;
+	while((c = getopt(argc, argv, "p:r:C:X:n:d:w:s:W:P:o:z:lv")) != -1) {
+		switch(c) {
+			case 'p': {
+				options.blockSizes.clear();
+				std::istringstream list(optarg);
+				std::string size;
+				while(std::getline(list, size, ','))
+					options.blockSizes.push_back(atoi(size.c_str()));
+				break;
+			}
+			case 'r': options.config.sampleRate = atof(optarg); break;
+			case 'C': options.config.analogChannels = atoi(optarg); break;
+			case 'X': options.config.multiplexerChannels = atoi(optarg); break;
+			case 'n': options.config.inputLevel = atof(optarg); break;
+			case 'd': options.durationSec = atof(optarg); break;
+			case 'w': options.warmupBlocks = atoi(optarg); break;
+			case 's': options.scriptPath = optarg; break;
+			case 'W': options.recordName = optarg; break;
+			case 'P': options.replayPath = optarg; break;
+			case 'o': options.outputName = optarg; break;
+			case 'z': options.sizesPath = optarg; break;
+			case 'l': options.latency = true; break;
+			case 'v': options.verbose = true; break;
+			default: return false;
+		}
+	}
+	for(auto size : options.blockSizes)
+		if(size == 0 || (size & (size - 1)))
+			return false;
+	return !options.blockSizes.empty() && options.config.sampleRate > 0;
+}
+
+// in render.cpp
+extern const char* gEventRecordPath;
+extern const char* gEventReplayPath;
+extern const char* gHeavySizesPath;
+extern bool gHeavySizing;
+
+static inline uint64_t nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static BenchResult runBlockSize(const BenchOptions& options, const SensorScript& sourceScript, unsigned int blockSize)
+{
+	BenchResult result = {};
+	result.blockSize = blockSize;
+
+	HostConfig config = options.config;
+	config.audioFrames = blockSize;
+	HostContext host(config);
+	SensorScript script = sourceScript;
+	BelaContext* context = host.get();
+	LatencyTracker tracker;
+	if(options.latency) {
+		LatencyTracker::active = &tracker;
+		script.setListener([&tracker](const SensorScript::Event& e, uint64_t frame) {
+			tracker.onScriptEvent(e, frame);
+		});
+	}
+
+	unsigned long long numBlocks = options.durationSec * config.sampleRate / blockSize;
+	std::vector<uint32_t> blockNs;
+	blockNs.reserve(numBlocks);
+
+	const std::string suffix = "-" + std::to_string(blockSize);
+	const std::string recordPath = options.recordName + suffix + ".tyev";
+	gEventRecordPath = options.recordName.empty() ? nullptr : recordPath.c_str();
+	gEventReplayPath = options.replayPath.empty() ? nullptr : options.replayPath.c_str();
+	// every block size adds to the same sizes file
+	gHeavySizesPath = options.sizesPath.empty() ? nullptr : options.sizesPath.c_str();
+	gHeavySizing = !options.sizesPath.empty();
+	FILE* output = nullptr;
+	if(!options.outputName.empty() && !(output = fopen((options.outputName + suffix + ".raw").c_str(), "wb")))
+		return result;
+
+	if(!setup(context, nullptr))
+		return result;
+	for(unsigned long long b = 0; b < numBlocks + options.warmupBlocks; ++b) {
+		host.fillAudioInput();
+		script.apply(host);
+		host.scanMultiplexer();
+		if(options.latency)
+			tracker.beginBlock(context->audioFramesElapsed, context->audioFrames);
+		uint64_t start = nowNs();
+		render(context, nullptr);
+		uint64_t end = nowNs();
+		if(b >= options.warmupBlocks)
+			blockNs.push_back(end - start);
+		if(output)
+			fwrite(context->audioOut, sizeof(float), context->audioFrames * context->audioOutChannels, output);
+		host.advance();
+	}
+	if(output)
+		fclose(output);
+	// as on the board, the auxiliary tasks are stopped before cleanup()
+	Bela_deleteAllAuxiliaryTasks();
+	cleanup(context, nullptr);
+	LatencyTracker::active = nullptr;
+	result.latency = tracker.getStats();
+
+	if(blockNs.empty())
+		return result;
+	double total = 0;
+	for(auto ns : blockNs)
+		total += ns;
+	std::sort(blockNs.begin(), blockNs.end());
+	result.ok = true;
+	result.blocks = blockNs.size();
+	result.budgetNs = host.getBlockPeriodNs();
+	result.meanNs = total / blockNs.size();
+	result.p99Ns = blockNs[(blockNs.size() - 1) * 99 / 100];
+	result.worstNs = blockNs.back();
+	return result;
+}
+
+static BenchResult runInChild(const BenchOptions& options, const SensorScript& script, unsigned int blockSize)
+{
+	BenchResult result = {};
+	result.blockSize = blockSize;
+	int fds[2];
+	if(pipe(fds))
+		return result;
+	fflush(stdout);
+	pid_t pid = fork();
+	if(pid == 0) {
+		close(fds[0]);
+		if(!options.verbose) {
+			// keep the setup() banner and the patch's print objects out of the report
+			int devNull = open("/dev/null", O_WRONLY);
+			dup2(devNull, STDOUT_FILENO);
+		}
+		result = runBlockSize(options, script, blockSize);
+		fflush(stdout);
+		if(write(fds[1], &result, sizeof(result)) != sizeof(result))
+			_exit(1);
+		_exit(0);
+	}
+	close(fds[1]);
+	if(pid > 0) {
+		if(read(fds[0], &result, sizeof(result)) != sizeof(result))
+			result.ok = false;
+		waitpid(pid, nullptr, 0);
+	}
+	close(fds[0]);
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	if(!parseOptions(argc, argv, options)) {
+		usage(argv[0]);
+		return 1;
+	}
+	SensorScript script;
+	if(!options.scriptPath.empty() && !script.load(options.scriptPath))
+		return 1;
+
+	printf("# script: %s (%zu events, %.0f ms loop)\n",
+		options.scriptPath.empty() ? "none" : options.scriptPath.c_str(),
+		script.getEvents().size(), script.getLengthMs());
+	printf("# %.0f Hz, %u analog channels, %u multiplexer channels, %.1f s per block size\n",
+		options.config.sampleRate, options.config.analogChannels,
+		options.config.multiplexerChannels, options.durationSec);
+	printf("# %6s %9s %10s %12s %10s %10s %10s %10s",
+		"block", "blocks", "budget ns", "mean ns", "p99 ns", "worst ns", "headroom", "worst hr");
+	if(options.latency)
+		printf(" %8s %8s %8s %8s %8s %6s", "events", "lat ms", "min ms", "max ms", "jitter", "lost");
+	printf("\n");
+
+	int ret = 0;
+	for(auto blockSize : options.blockSizes) {
+		BenchResult r = runInChild(options, script, blockSize);
+		if(!r.ok) {
+			printf("  %6u failed\n", blockSize);
+			ret = 1;
+			continue;
+		}
+		printf("  %6u %9llu %10.0f %12.1f %10.0f %10.0f %9.1f%% %9.1f%%",
+			r.blockSize, r.blocks, r.budgetNs, r.meanNs, r.p99Ns, r.worstNs,
+			100 * (1 - r.meanNs / r.budgetNs), 100 * (1 - r.worstNs / r.budgetNs));
+		if(options.latency) {
+			const double msPerSample = 1000 / options.config.sampleRate;
+			const LatencyTracker::Stats& l = r.latency;
+			printf(" %8llu %8.3f %8.3f %8.3f %8.3f %6llu", l.events,
+				l.meanSamples * msPerSample, l.minSamples * msPerSample,
+				l.maxSamples * msPerSample, l.jitterSamples * msPerSample, l.unmatched);
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+	return ret;
+}
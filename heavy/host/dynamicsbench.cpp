@@ -0,0 +1,349 @@
+/*
+ * Dynamics benchmark
+ * ------------------
+ * Runs the distortion and the compressor of filters~ two ways over the same
+ * signal: as the patch runs them, from the Heavy operations [hv.tanh~] and
+ * [hv.compressor~] are exported to, and through Saturator and Compressor.
+ *
+ * For the distortion, each shape of Saturator against the exported chain,
+ * over noise that drives it well into the curve: the time per frame, the
+ * largest error against tanh in double precision, relative to the output
+ * peak, and the aliasing of a 7 kHz sine, as the power off its harmonics
+ * relative to the power on them.
+ *
+ * For the compressor, noise that steps between loud and quiet every 250 ms:
+ * the time per frame of each, and the largest difference between them,
+ * relative to the output peak. The Heavy side runs [env~] and [line~] on
+ * their own with the messages between them scheduled as in the patch.
+ *
+ * Each figure is for one channel of one voice; the patch runs six of each.
+ *
+ * Usage: dynamicsbench [-g 4] [-k 5] [-r 44100] [-p 16] [-d 10]
+ */
+
+#include "Compressor.h"
+#include "Saturator.h"
+#include <HeavyContext.hpp>
+#include <HvSignalEnvelope.h>
+#include <HvSignalLine.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+struct BenchOptions {
+	float drive = 4; // distparam, 0.1 to 100
+	float komp = 5; // kompparam, 0 to 10
+	float sampleRate = 44100;
+	unsigned int blockSize = 16;
+	double durationSec = 10;
+};
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [-g drive] [-k komp] [-r samplerate] [-p blocksize] [-d seconds]\n", name);
+}
+
+static bool parseOptions(int argc, char** argv, BenchOptions& options)
+{
+	int c;
+	while((c = getopt(argc, argv, "g:k:r:p:d:")) != -1) {
+		switch(c) {
+			case 'g': options.drive = atof(optarg); break;
+			case 'k': options.komp = atof(optarg); break;
+			case 'r': options.sampleRate = atof(optarg); break;
+			case 'p': options.blockSize = atoi(optarg); break;
+			case 'd': options.durationSec = atof(optarg); break;
+			default: return false;
+		}
+	}
+	return options.drive > 0 && options.komp >= 0 && options.sampleRate > 0 && options.blockSize > 0
+		&& options.blockSize % HV_N_SIMD == 0;
+}
+
+static void splat(float value, hv_bufferf_t* b)
+{
+	alignas(32) float values[HV_N_SIMD];
+	std::fill_n(values, HV_N_SIMD, value);
+	__hv_load_f(values, b);
+}
+
+static inline uint64_t nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// The dist subpatch as exported: [*~] by the drive, [hv.tanh~], and [/~] by
+// [sqrt~] of the drive
+struct HeavyDist {
+	hv_bufferf_t drive, three, minusThree, nine, twentySeven;
+
+	void setup(float d)
+	{
+		splat(d, &drive);
+		splat(3, &three);
+		splat(-3, &minusThree);
+		splat(9, &nine);
+		splat(27, &twentySeven);
+	}
+
+	void process(const float* in, float* out, unsigned int numFrames)
+	{
+		hv_bufferf_t x, x2, a, b, mask, root;
+		for(unsigned int n = 0; n < numFrames; n += HV_N_SIMD) {
+			__hv_load_f((float*)in + n, &x);
+			__hv_mul_f(x, drive, &x);
+			__hv_min_f(x, three, &x);
+			__hv_max_f(x, minusThree, &x);
+			__hv_mul_f(x, x, &x2);
+			__hv_add_f(x2, twentySeven, &a);
+			__hv_fma_f(x2, nine, twentySeven, &b);
+			__hv_div_f(a, b, &b);
+			__hv_mul_f(x, b, &x);
+			__hv_zero_f(&a);
+			__hv_gt_f(drive, a, &mask);
+			__hv_sqrt_f(drive, &root);
+			__hv_and_f(mask, root, &root);
+			__hv_div_f(x, root, &x);
+			__hv_store_f(out + n, x);
+		}
+	}
+};
+
+// [hv.compressor~] as exported: [env~ 256] and [line~], with the control
+// objects between them worked out in the message from [env~]
+struct HeavyCompressor {
+	SignalEnvelope envelope;
+	SignalLine line;
+	float threshold;
+	float ratio;
+	float previous; // [f] in attackrelease
+};
+
+// Just enough of a context for [env~] to schedule its messages in and
+// [line~] to read the sample rate from
+class BenchContext : public HeavyContext {
+public:
+	BenchContext(double sampleRate, HeavyCompressor& c) : HeavyContext(sampleRate), compressor(c)
+	{
+		sEnv_init(&compressor.envelope, Compressor::kWindowSize, 2 * Compressor::kWindowSize);
+		sLine_init(&compressor.line);
+		compressor.previous = 0;
+	}
+
+	~BenchContext()
+	{
+		sEnv_free(&compressor.envelope);
+	}
+
+	void run(const float* in, float* out, unsigned int numFrames)
+	{
+		hv_bufferf_t x, gain;
+		for(unsigned int n = 0; n < numFrames; n += HV_N_SIMD) {
+			const hv_uint32_t nextBlock = blockStartTimestamp + HV_N_SIMD;
+			while(mq_hasMessageBefore(&mq, nextBlock)) {
+				MessageNode* const node = mq_peek(&mq);
+				node->sendMessage(this, node->let, node->m);
+				mq_pop(&mq);
+			}
+			__hv_load_f((float*)in + n, &x);
+			sEnv_process(this, &compressor.envelope, x, &onLevel);
+			__hv_line_f(&compressor.line, &gain);
+			__hv_mul_f(x, gain, &x);
+			__hv_store_f(out + n, x);
+			blockStartTimestamp = nextBlock;
+		}
+	}
+
+	const char* getName() override { return "dynamicsbench"; }
+	int getNumInputChannels() override { return 1; }
+	int getNumOutputChannels() override { return 1; }
+	int process(float**, float**, int) override { return 0; }
+	int processInline(float*, float*, int) override { return 0; }
+	int processInlineInterleaved(float*, float*, int) override { return 0; }
+	int getParameterInfo(int, HvParameterInfo*) override { return 0; }
+
+private:
+	static void onLevel(HeavyContextInterface* c, int letIn, const HvMessage* m)
+	{
+		HeavyCompressor& compressor = static_cast<BenchContext*>(c)->compressor;
+		const float level = msg_getFloat(m, 0);
+		float reduction = 1;
+		if(level >= compressor.threshold) {
+			const float output = (level - compressor.threshold) / compressor.ratio + compressor.threshold;
+			reduction = hv_pow_f(10.f, (output - level) / 20.f);
+		}
+		const float time = (reduction - compressor.previous > 0) * 100 + 5;
+		compressor.previous = reduction;
+		HvMessage* ramp = HV_MESSAGE_ON_STACK(2);
+		msg_init(ramp, 2, msg_getTimestamp(m));
+		msg_setFloat(ramp, 0, std::min(reduction, 1.f));
+		msg_setFloat(ramp, 1, time);
+		sLine_onMessage(c, &compressor.line, 0, ramp, nullptr);
+	}
+
+	HvTable* getTableForHash(hv_uint32_t) override { return nullptr; }
+	void scheduleMessageForReceiver(hv_uint32_t, HvMessage*) override {}
+
+	HeavyCompressor& compressor;
+};
+
+// Power off the harmonics of a sine on bin m of n, over the power on them
+static double aliasing(const std::function<void(const float*, float*, unsigned int)>& process,
+		unsigned int blockSize)
+{
+	const unsigned int n = 4096;
+	const unsigned int m = 651;
+	std::vector<float> in(2 * n), out(2 * n);
+	for(unsigned int k = 0; k < 2 * n; ++k)
+		in[k] = sin(2 * M_PI * m * (k % n) / n);
+	for(unsigned int k = 0; k < 2 * n; k += blockSize)
+		process(&in[k], &out[k], std::min(blockSize, 2 * n - k));
+	// the second period, once the filters have settled
+	const float* y = &out[n];
+	std::vector<double> cosine(n), sine(n);
+	for(unsigned int k = 0; k < n; ++k) {
+		cosine[k] = cos(2 * M_PI * k / n);
+		sine[k] = sin(2 * M_PI * k / n);
+	}
+	double on = 0, off = 0;
+	for(unsigned int bin = 1; bin < n / 2; ++bin) {
+		double re = 0, im = 0;
+		for(unsigned int k = 0; k < n; ++k) {
+			const unsigned int phase = bin * k % n;
+			re += y[k] * cosine[phase];
+			im -= y[k] * sine[phase];
+		}
+		(bin % m ? off : on) += re * re + im * im;
+	}
+	return 10 * log10(off / on + 1e-30);
+}
+
+static void benchDist(const BenchOptions& options)
+{
+	const unsigned int blockSize = options.blockSize;
+	const uint64_t numBlocks = options.durationSec * options.sampleRate / blockSize;
+	const float peak = 1 / sqrtf(options.drive);
+
+	HeavyDist heavy;
+	heavy.setup(options.drive);
+	Saturator saturators[3];
+	const char* const names[] = { "pade", "rational", "2x" };
+	for(unsigned int s = 0; s < 3; ++s) {
+		saturators[s].setup((Saturator::Quality)s);
+		saturators[s].setDrive(options.drive);
+	}
+
+	// noise over twice the range [hv.tanh~] is clipped to
+	std::vector<float> in(blockSize), heavyOut(blockSize), out(blockSize);
+	std::minstd_rand noise(1);
+	std::uniform_real_distribution<float> uniform(-6 / options.drive, 6 / options.drive);
+	uint64_t heavyNs = 0, ns[3] = {};
+	double heavyError = 0, error[3] = {};
+	for(uint64_t b = 0; b < numBlocks; ++b) {
+		for(auto& x : in)
+			x = uniform(noise);
+		uint64_t t0 = nowNs();
+		heavy.process(in.data(), heavyOut.data(), blockSize);
+		heavyNs += nowNs() - t0;
+		for(unsigned int n = 0; n < blockSize; ++n)
+			heavyError = std::max(heavyError, fabs(heavyOut[n] - tanh((double)options.drive * in[n]) * peak));
+		for(unsigned int s = 0; s < 3; ++s) {
+			t0 = nowNs();
+			saturators[s].process(in.data(), out.data(), blockSize);
+			ns[s] += nowNs() - t0;
+			if(saturators[s].getLatency())
+				continue;
+			for(unsigned int n = 0; n < blockSize; ++n)
+				error[s] = std::max(error[s], fabs(out[n] - tanh((double)options.drive * in[n]) * peak));
+		}
+	}
+
+	const double frames = (double)numBlocks * blockSize;
+	printf("# dist: drive %g, %.0f Hz, block %u, %.1f s\n", options.drive, options.sampleRate, blockSize,
+			frames / options.sampleRate);
+	printf("#          ns/frame  speed-up     error  aliasing\n");
+	const double heavyAliasing = aliasing([&](const float* in, float* out, unsigned int n) {
+			heavy.process(in, out, n);
+		}, blockSize);
+	printf("  heavy    %8.2f  %8.1fx  %5.1f dB  %5.1f dB\n", heavyNs / frames, 1.0,
+			20 * log10(heavyError / peak + 1e-30), heavyAliasing);
+	for(unsigned int s = 0; s < 3; ++s) {
+		saturators[s].reset();
+		const double a = aliasing([&](const float* in, float* out, unsigned int n) {
+				saturators[s].process(in, out, n);
+			}, blockSize);
+		if(saturators[s].getLatency())
+			printf("  %-8s %8.2f  %8.1fx  %8s  %5.1f dB\n", names[s], ns[s] / frames, (double)heavyNs / ns[s], "-", a);
+		else
+			printf("  %-8s %8.2f  %8.1fx  %5.1f dB  %5.1f dB\n", names[s], ns[s] / frames, (double)heavyNs / ns[s],
+					20 * log10(error[s] / peak + 1e-30), a);
+	}
+}
+
+static void benchCompressor(const BenchOptions& options)
+{
+	const unsigned int blockSize = options.blockSize;
+	const uint64_t numBlocks = options.durationSec * options.sampleRate / blockSize;
+	// as kompparam sets them
+	const float komp = std::min(options.komp, 10.f);
+	const float threshold = 3 * komp;
+	const float ratio = expf(komp / 3.5f);
+
+	HeavyCompressor heavyCompressor;
+	heavyCompressor.threshold = threshold;
+	heavyCompressor.ratio = ratio;
+	BenchContext heavy(options.sampleRate, heavyCompressor);
+	Compressor compressor;
+	compressor.setup(options.sampleRate);
+	compressor.setThreshold(threshold);
+	compressor.setRatio(ratio);
+
+	std::vector<float> in(blockSize), heavyOut(blockSize), out(blockSize);
+	std::minstd_rand noise(1);
+	std::uniform_real_distribution<float> uniform(-1, 1);
+	const uint64_t stepFrames = options.sampleRate / 4;
+	uint64_t heavyNs = 0, ns = 0;
+	double peak = 0, error = 0;
+	for(uint64_t b = 0; b < numBlocks; ++b) {
+		for(unsigned int n = 0; n < blockSize; ++n)
+			in[n] = uniform(noise) * ((b * blockSize + n) / stepFrames % 2 ? 0.003f : 0.3f);
+		uint64_t t0 = nowNs();
+		heavy.run(in.data(), heavyOut.data(), blockSize);
+		uint64_t t1 = nowNs();
+		compressor.process(in.data(), out.data(), blockSize);
+		uint64_t t2 = nowNs();
+		heavyNs += t1 - t0;
+		ns += t2 - t1;
+		for(unsigned int n = 0; n < blockSize; ++n) {
+			peak = std::max(peak, (double)fabsf(heavyOut[n]));
+			error = std::max(error, (double)fabsf(out[n] - heavyOut[n]));
+		}
+	}
+
+	const double frames = (double)numBlocks * blockSize;
+	printf("# compressor: threshold %.1f dB, ratio %.2f, %.0f Hz, block %u, %.1f s\n", threshold, ratio,
+			options.sampleRate, blockSize, frames / options.sampleRate);
+	printf("#          ns/frame  speed-up  difference\n");
+	printf("  heavy    %8.2f  %8.1fx\n", heavyNs / frames, 1.0);
+	printf("  kernel   %8.2f  %8.1fx  %5.1f dB\n", ns / frames, (double)heavyNs / ns, 20 * log10(error / peak + 1e-30));
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	if(!parseOptions(argc, argv, options)) {
+		usage(argv[0]);
+		return 1;
+	}
+	benchDist(options);
+	benchCompressor(options);
+	return 0;
+}
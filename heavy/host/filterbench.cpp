@@ -0,0 +1,344 @@
+/*
+ * Filter bank benchmark
+ * ---------------------
+ * Runs the resonator and peak sections of filters~ two ways over the same
+ * noise and compares them: once as the patch runs them, one section after
+ * the other from Heavy's own [cpole~] and the signal operations the zeros
+ * are made of, and once as a single FilterBank with one lane per section.
+ * Reports the time per frame of each, and the largest error of each against
+ * the same sections run in double precision, relative to the output peak.
+ *
+ * Every voice gets the sections of one key from -k, as voiced by the
+ * tables: R1 and R2 through reson, P1 through peak, each in stereo, so three
+ * voices come to 18 lanes. The sections come from a VoicingCache, with the
+ * category of each key from t-Kat, and are fixed for the run, where the patch
+ * works them out again on every sample. Also reports how long building the
+ * cache takes, and what a lookup costs against working the coefficients out.
+ *
+ * Usage: filterbench [-t ../tables.bin] [-k 0,1,3] [-r 44100] [-p 16] [-d 10]
+ */
+
+#include "FilterBank.h"
+#include "TableBlob.h"
+#include "VoicingCache.h"
+#include <HvSignalCPole.h>
+#include <HvSignalDel1.h>
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+struct BenchOptions {
+	std::string tablesPath = "../tables.bin";
+	std::vector<unsigned int> keys = { 0, 1, 3 };
+	float sampleRate = 44100;
+	unsigned int blockSize = 16;
+	double durationSec = 10;
+};
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [-t tables.bin] [-k keys] [-r samplerate] [-p blocksize] [-d seconds]\n", name);
+}
+
+static bool parseOptions(int argc, char** argv, BenchOptions& options)
+{
+	int c;
+	while((c = getopt(argc, argv, "t:k:r:p:d:")) != -1) {
+		switch(c) {
+			case 't': options.tablesPath = optarg; break;
+			case 'k': {
+				options.keys.clear();
+				std::istringstream list(optarg);
+				std::string key;
+				while(std::getline(list, key, ','))
+					options.keys.push_back(atoi(key.c_str()));
+				break;
+			}
+			case 'r': options.sampleRate = atof(optarg); break;
+			case 'p': options.blockSize = atoi(optarg); break;
+			case 'd': options.durationSec = atof(optarg); break;
+			default: return false;
+		}
+	}
+	return !options.keys.empty() && options.sampleRate > 0 && options.blockSize > 0
+		&& options.blockSize % HV_N_SIMD == 0;
+}
+
+static const float* findTable(const TableBlob& tables, const char* name, unsigned int minLength)
+{
+	for(unsigned int n = 0; n < tables.getNumTables(); ++n)
+		if(!strcmp(tables.getEntry(n).name, name) && tables.getEntry(n).length >= minLength)
+			return tables.getValues(n);
+	fprintf(stderr, "Error: no table %s with %u values\n", name, minLength);
+	return nullptr;
+}
+
+static void splat(float value, hv_bufferf_t* b)
+{
+	alignas(32) float values[HV_N_SIMD];
+	std::fill_n(values, HV_N_SIMD, value);
+	__hv_load_f(values, b);
+}
+
+// One section as Heavy runs it: the gain, two [cpole~] and either two
+// [rzero~] or two [czero~], every coefficient a signal
+struct HeavySection {
+	bool peak;
+	hv_bufferf_t gain;
+	hv_bufferf_t pole[2][2]; // re, im, negated
+	hv_bufferf_t zero[2][2]; // re, im, only the re of a [rzero~]
+	SignalCPole cpole[2];
+	SignalDel1 zeroDel[2][2];
+
+	void setup(bool isPeak, const double* p)
+	{
+		peak = isPeak;
+		splat(p[0], &gain);
+		for(unsigned int k = 0; k < 2; ++k) {
+			// hvcc negates the coefficients of a [cpole~], as __hv_cpole_f
+			// subtracts where cpole~ adds
+			splat(-p[1 + 2 * k], &pole[k][0]);
+			splat(-p[2 + 2 * k], &pole[k][1]);
+			splat(p[5 + 2 * k], &zero[k][0]);
+			splat(p[6 + 2 * k], &zero[k][1]);
+			sCPole_init(&cpole[k]);
+			sDel1_init(&zeroDel[k][0]);
+			sDel1_init(&zeroDel[k][1]);
+		}
+	}
+
+	void process(const float* in, float* out, unsigned int numFrames)
+	{
+		hv_bufferf_t x, re, im, zeroRe, zeroIm, prevRe, prevIm, t;
+		__hv_zero_f(&zeroIm);
+		for(unsigned int n = 0; n < numFrames; n += HV_N_SIMD) {
+			__hv_load_f((float*)in + n, &x);
+			__hv_mul_f(x, gain, &x);
+			__hv_cpole_f(&cpole[0], x, zeroIm, pole[0][0], pole[0][1], &re, &im);
+			__hv_cpole_f(&cpole[1], re, im, pole[1][0], pole[1][1], &re, &im);
+			for(unsigned int k = 0; k < 2; ++k) {
+				// y = x - a x[n-1]
+				__hv_del1_f(&zeroDel[k][0], re, &prevRe);
+				if(!peak) {
+					__hv_mul_f(zero[k][0], prevRe, &t);
+					__hv_sub_f(re, t, &re);
+					continue;
+				}
+				__hv_del1_f(&zeroDel[k][1], im, &prevIm);
+				__hv_mul_f(zero[k][0], prevRe, &t);
+				__hv_fms_f(zero[k][1], prevIm, t, &zeroRe); // ai yi1 - ar yr1
+				__hv_mul_f(zero[k][0], prevIm, &t);
+				__hv_fma_f(zero[k][1], prevRe, t, &zeroIm); // ar yi1 + ai yr1
+				__hv_add_f(re, zeroRe, &re);
+				__hv_sub_f(im, zeroIm, &im);
+				__hv_zero_f(&zeroIm);
+			}
+			__hv_store_f(out + n, re);
+		}
+	}
+};
+
+// The same in double precision, as cpole~, rzero~ and czero~ define them
+struct ReferenceSection {
+	typedef std::complex<double> Complex;
+	double gain;
+	Complex pole[2];
+	Complex zero[2];
+	Complex y[2]; // last output of each pole
+	Complex x[2]; // last input of each zero
+
+	void setup(const double* p)
+	{
+		gain = p[0];
+		for(unsigned int k = 0; k < 2; ++k) {
+			pole[k] = Complex(p[1 + 2 * k], p[2 + 2 * k]);
+			zero[k] = Complex(p[5 + 2 * k], p[6 + 2 * k]);
+			y[k] = x[k] = 0;
+		}
+	}
+
+	double process(double in)
+	{
+		Complex v = in * gain;
+		for(unsigned int k = 0; k < 2; ++k)
+			v = y[k] = v + pole[k] * y[k];
+		for(unsigned int k = 0; k < 2; ++k) {
+			Complex w = v - zero[k] * x[k];
+			x[k] = v;
+			v = w;
+		}
+		return v.real();
+	}
+};
+
+// The outputs of resonparams: re, im and -im of the pole, sqrt r and -sqrt r
+static void resonParams(float sampleRate, float freq, float q, float gain, double* p)
+{
+	const double w = 2 * M_PI * freq / sampleRate;
+	const double r = exp(-w / q);
+	const double params[] = { gain, r * cos(w), r * sin(w), r * cos(w), -r * sin(w), sqrt(r), 0, -sqrt(r), 0 };
+	memcpy(p, params, sizeof(params));
+}
+
+// The outputs of peakparams: g, the poles from rootsa and the zeros from rootsb
+static void peakParams(float sampleRate, float freq, float q, float gain, double* p)
+{
+	const double a = sqrt(gain);
+	const double cosw = cos(2 * M_PI * freq / sampleRate);
+	const double alpha = sqrt(1 - cosw * cosw) / (2 * q);
+	const double a0 = 1 + alpha / a;
+	const double a1 = cosw / a0;
+	const double a2 = (1 - alpha / a) / a0;
+	const double b1 = a1 / (1 + alpha * a);
+	const double b2 = (1 - alpha * a) / a0 / (1 + alpha * a);
+	const double poleIm = sqrt(fabs(a1 * a1 - a2));
+	const double d = b1 * b1 - b2;
+	const double s = sqrt(fabs(d));
+	const double params[] = { (1 + alpha * a) / a0, a1, poleIm, a1, -poleIm,
+			b1 + (d > 0) * s, (d < 0) * s, b1 - (d > 0) * s, -(d < 0) * s };
+	memcpy(p, params, sizeof(params));
+}
+
+static inline uint64_t nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	if(!parseOptions(argc, argv, options)) {
+		usage(argv[0]);
+		return 1;
+	}
+	TableBlob tables;
+	if(!tables.open(options.tablesPath.c_str()))
+		return 1;
+	const unsigned int maxKey = *std::max_element(options.keys.begin(), options.keys.end());
+	const float* kats = findTable(tables, "t-Kat", maxKey + 1);
+	if(!kats)
+		return 1;
+	VoicingCache cache;
+	const uint64_t buildStart = nowNs();
+	if(!cache.build(tables, options.sampleRate))
+		return 1;
+	const uint64_t buildNs = nowNs() - buildStart;
+	std::vector<const VoicingCache::Voicing*> voicings;
+	for(unsigned int key : options.keys) {
+		const VoicingCache::Voicing* voicing = cache.lookup(key, kats[key]);
+		if(!voicing) {
+			fprintf(stderr, "Error: no voicing for key %u\n", key);
+			return 1;
+		}
+		voicings.push_back(voicing);
+	}
+
+	// lanes: voice v, section s (R1, R2, P1), channel c at v * 6 + s * 2 + c
+	const unsigned int numLanes = options.keys.size() * 6;
+	std::vector<HeavySection> sections(numLanes);
+	std::vector<ReferenceSection> references(numLanes);
+	FilterBank bank;
+	bank.setup(numLanes);
+	for(unsigned int v = 0; v < options.keys.size(); ++v) {
+		for(unsigned int s = 0; s < VoicingCache::kNumStages; ++s) {
+			const auto& stage = voicings[v]->stages[s];
+			const bool peak = s == VoicingCache::kP1;
+			double params[9];
+			(peak ? peakParams : resonParams)(options.sampleRate, stage.freq, stage.q, stage.gain, params);
+			FilterBank::Coefficients c = stage.coefficients;
+			if(!peak) {
+				// the cache keeps the resonators at unit gain
+				c.b0 *= stage.gain;
+				c.b2 *= stage.gain;
+			}
+			for(unsigned int ch = 0; ch < 2; ++ch) {
+				sections[v * 6 + s * 2 + ch].setup(peak, params);
+				references[v * 6 + s * 2 + ch].setup(params);
+				bank.setCoefficients(v * 6 + s * 2 + ch, c);
+			}
+		}
+	}
+
+	const unsigned int blockSize = options.blockSize;
+	const unsigned int stride = bank.getStride();
+	const uint64_t numBlocks = options.durationSec * options.sampleRate / blockSize;
+	std::vector<float> in(blockSize);
+	std::vector<float> heavyOut(numLanes * blockSize);
+	std::vector<float> bankBuffer(stride * blockSize);
+	std::minstd_rand noise(1);
+	std::uniform_real_distribution<float> uniform(-0.1f, 0.1f);
+	uint64_t heavyNs = 0, bankNs = 0;
+	double peak = 0, heavyError = 0, bankError = 0;
+	for(uint64_t b = 0; b < numBlocks; ++b) {
+		for(auto& x : in)
+			x = uniform(noise);
+
+		uint64_t t0 = nowNs();
+		for(unsigned int l = 0; l < numLanes; ++l)
+			sections[l].process(in.data(), &heavyOut[l * blockSize], blockSize);
+		uint64_t t1 = nowNs();
+		for(unsigned int n = 0; n < blockSize; ++n)
+			std::fill_n(&bankBuffer[n * stride], stride, in[n]);
+		bank.process(bankBuffer.data(), bankBuffer.data(), blockSize);
+		uint64_t t2 = nowNs();
+		heavyNs += t1 - t0;
+		bankNs += t2 - t1;
+
+		for(unsigned int l = 0; l < numLanes; ++l) {
+			for(unsigned int n = 0; n < blockSize; ++n) {
+				const double y = references[l].process(in[n]);
+				peak = std::max(peak, fabs(y));
+				heavyError = std::max(heavyError, fabs(heavyOut[l * blockSize + n] - y));
+				bankError = std::max(bankError, fabs(bankBuffer[n * stride + l] - y));
+			}
+		}
+	}
+
+	// what a voice would pay on note on: look its sections up, or work them out
+	const unsigned int numKeys = cache.getNumKeys();
+	const unsigned int numKats = cache.getNumKats();
+	const unsigned int numTrials = 100000;
+	volatile float sink; // keeps the loops from being optimised away
+	const uint64_t lookupStart = nowNs();
+	for(unsigned int n = 0; n < numTrials; ++n) {
+		const VoicingCache::Voicing* voicing = cache.lookup(n % numKeys, n % numKats);
+		for(const auto& stage : voicing->stages)
+			sink = stage.coefficients.b0;
+	}
+	const uint64_t computeStart = nowNs();
+	for(unsigned int n = 0; n < numTrials; ++n) {
+		const VoicingCache::Voicing* voicing = cache.lookup(n % numKeys, n % numKats);
+		sink = FilterBank::resonator(options.sampleRate, voicing->stages[0].freq, voicing->stages[0].q, 1).b0;
+		sink = FilterBank::resonator(options.sampleRate, voicing->stages[1].freq, voicing->stages[1].q, 1).b0;
+		sink = FilterBank::peak(options.sampleRate, voicing->stages[2].freq, voicing->stages[2].q,
+				voicing->stages[2].gain).b0;
+	}
+	const uint64_t computeEnd = nowNs();
+	(void)sink;
+	const double lookupNs = (double)(computeStart - lookupStart) / numTrials;
+	const double computeNs = (double)(computeEnd - computeStart) / numTrials - lookupNs;
+
+	const double frames = (double)numBlocks * blockSize;
+	printf("# %u voices, %u lanes, %.0f Hz, block %u, %.1f s\n", (unsigned int)options.keys.size(), numLanes,
+			options.sampleRate, blockSize, frames / options.sampleRate);
+	printf("# output peak %.3g, error against double precision\n", peak);
+	printf("#         ns/frame  speed-up     error\n");
+	printf("  heavy   %8.1f  %8.1fx  %5.1f dB\n", heavyNs / frames, 1.0, 20 * log10(heavyError / peak + 1e-30));
+	printf("  bank    %8.1f  %8.1fx  %5.1f dB\n", bankNs / frames, (double)heavyNs / bankNs,
+			20 * log10(bankError / peak + 1e-30));
+	printf("# voicing cache: %u keys x %u categories built in %.1f us\n", numKeys, numKats, buildNs / 1000.0);
+	printf("  lookup  %8.1f ns/voice\n", lookupNs);
+	printf("  compute %8.1f ns/voice\n", computeNs);
+	return 0;
+}
@@ -0,0 +1,35 @@
+/*
+ * Host stand-in for Bela's Scope library
+ * --------------------------------------
+ * Accepts and discards logged frames. Only the calling pattern matters for
+ * profiling render(); there is no browser to send the data to on the host.
+ */
+
+#ifndef SCOPE_HOST_H_
+#define SCOPE_HOST_H_
+
+class Scope {
+public:
+	Scope() : numChannels(0), sampleRate(0), framesLogged(0) {}
+
+	void setup(unsigned int channels, float rate) {
+		numChannels = channels;
+		sampleRate = rate;
+	}
+
+	void log(const float* values) {
+		(void)values;
+		++framesLogged;
+	}
+
+	bool trigger() { return true; }
+
+	unsigned long long getFramesLogged() const { return framesLogged; }
+
+private:
+	unsigned int numChannels;
+	float sampleRate;
+	unsigned long long framesLogged;
+};
+
+#endif // SCOPE_HOST_H_
@@ -0,0 +1,79 @@
+/*
+ * tablepack
+ * ---------
+ * Compiles voicing tables in the text format of tables/ (whitespace separated
+ * values with comma decimals, as written by the spreadsheet) into the binary
+ * file read by TableBlob. Each table is named after its file, without the
+ * directory and the .txt extension.
+ *
+ * Usage: tablepack -o tables.bin tables/t-Kat.txt tables/f-Komp.txt ...
+ */
+
+#include "TableBlob.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static bool readTable(const std::string& path, TableBlob::Table& table)
+{
+	std::ifstream file(path);
+	if(!file) {
+		fprintf(stderr, "Error: cannot open %s\n", path.c_str());
+		return false;
+	}
+	std::stringstream text;
+	text << file.rdbuf();
+	std::string contents = text.str();
+	std::replace(contents.begin(), contents.end(), ',', '.');
+
+	std::istringstream words(contents);
+	std::string word;
+	while(words >> word) {
+		char* end;
+		float value = strtof(word.c_str(), &end);
+		if(*end) {
+			fprintf(stderr, "Error: %s: '%s' is not a number\n", path.c_str(), word.c_str());
+			return false;
+		}
+		table.values.push_back(value);
+	}
+
+	size_t start = path.find_last_of('/');
+	table.name = path.substr(start == std::string::npos ? 0 : start + 1);
+	if(table.name.size() > 4 && table.name.compare(table.name.size() - 4, 4, ".txt") == 0)
+		table.name.resize(table.name.size() - 4);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	const char* output = nullptr;
+	int c;
+	while((c = getopt(argc, argv, "o:")) != -1) {
+		if(c != 'o') {
+			output = nullptr;
+			break;
+		}
+		output = optarg;
+	}
+	if(!output || optind == argc) {
+		fprintf(stderr, "Usage: %s -o tables.bin table.txt...\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<TableBlob::Table> tables(argc - optind);
+	for(unsigned int n = 0; n < tables.size(); ++n)
+		if(!readTable(argv[optind + n], tables[n]))
+			return 1;
+	if(!TableBlob::write(output, tables))
+		return 1;
+
+	TableBlob check;
+	if(!check.open(output))
+		return 1;
+	printf("%s: %u tables\n", output, check.getNumTables());
+	return 0;
+}
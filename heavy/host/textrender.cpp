@@ -0,0 +1,401 @@
+/*
+ * Offline text renderer
+ * ---------------------
+ * Types text files on the patch and writes what it plays to WAV files, as
+ * fast as the machine allows.
+ *
+ * Every character is looked up in keylist.txt, which lists the character of
+ * each key index m * 8 + n in order, and played as the instrument would see
+ * it: keystatus [index 1(, the velocity to nedslag1vel and a bang to
+ * nedslag1 when the type bar hits, then keystatus [index 0( when the key is
+ * released. Letters match either case, a space is a keystroke without a key
+ * and a new line waits for the carriage return. Other characters are skipped
+ * and counted.
+ *
+ * The patch filters what the microphone picks up from the typewriter, so
+ * every hit also plays a burst of noise into the audio inputs, -A loud at
+ * full velocity and decaying by 60 dB over -D ms.
+ *
+ * Keystrokes come at the rate given by -m in words per minute (five
+ * characters to a word), each moved by up to -J ms at random from a seeded
+ * generator, so a run is repeatable. The audio outputs are scaled by the
+ * same tremolo as in render.cpp.
+ *
+ * Documents are rendered in parallel, each worker thread running its own
+ * Heavy context. Each input file.txt is written to <outdir>/file.wav as
+ * stereo 32-bit float.
+ *
+ * Usage: textrender [-k keylist.txt] [-t tables.bin] [-m 40] [-J 30] [-H 70]
+ *                   [-T 18] [-V 0.8] [-A 0.1] [-D 20] [-N 1000] [-e 2]
+ *                   [-r 44100] [-p 16] [-j threads] [-S seed] [-o outdir]
+ *                   file.txt...
+ */
+
+#include <Heavy_bela.h>
+#include "TableBlob.h"
+#include "Tremolo.h"
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+struct RenderOptions {
+	std::string keylistPath = "../../tables/keylist.txt";
+	std::string tablesPath;
+	std::string outputDir = ".";
+	float wordsPerMinute = 40;
+	float jitterMs = 30;
+	float holdMs = 70;
+	float hitMs = 18;
+	float velocity = 0.8f;
+	float burstLevel = 0.1f;
+	float burstMs = 20;
+	float newlineMs = 1000;
+	float tailSec = 2;
+	float sampleRate = 44100;
+	unsigned int blockSize = 16;
+	unsigned int threads = 0;
+	unsigned int seed = 1;
+	std::vector<std::string> inputs;
+};
+
+struct KeyEvent {
+	enum Type { kPress, kHit, kRelease };
+	uint64_t frame;
+	Type type;
+	unsigned int key;
+};
+
+struct Document {
+	std::string inputPath;
+	std::string outputPath;
+	std::vector<KeyEvent> events;
+	unsigned int skipped = 0;
+	uint64_t lengthFrames = 0;
+	bool ok = false;
+	double seconds = 0;
+};
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [-k keylist] [-t tables.bin] [-m wpm] [-J jitterms] [-H holdms] [-T hitms]\n"
+		"       [-V velocity] [-A burstlevel] [-D burstms] [-N newlinems] [-e tailsec] [-r samplerate]\n"
+		"       [-p blocksize] [-j threads] [-S seed] [-o outdir] file.txt...\n", name);
+}
+
+static bool parseOptions(int argc, char** argv, RenderOptions& options)
+{
+	int c;
+	while((c = getopt(argc, argv, "k:t:m:J:H:T:V:A:D:N:e:r:p:j:S:o:")) != -1) {
+		switch(c) {
+			case 'k': options.keylistPath = optarg; break;
+			case 't': options.tablesPath = optarg; break;
+			case 'm': options.wordsPerMinute = atof(optarg); break;
+			case 'J': options.jitterMs = atof(optarg); break;
+			case 'H': options.holdMs = atof(optarg); break;
+			case 'T': options.hitMs = atof(optarg); break;
+			case 'V': options.velocity = atof(optarg); break;
+			case 'A': options.burstLevel = atof(optarg); break;
+			case 'D': options.burstMs = atof(optarg); break;
+			case 'N': options.newlineMs = atof(optarg); break;
+			case 'e': options.tailSec = atof(optarg); break;
+			case 'r': options.sampleRate = atof(optarg); break;
+			case 'p': options.blockSize = atoi(optarg); break;
+			case 'j': options.threads = atoi(optarg); break;
+			case 'S': options.seed = atoi(optarg); break;
+			case 'o': options.outputDir = optarg; break;
+			default: return false;
+		}
+	}
+	for(int n = optind; n < argc; ++n)
+		options.inputs.push_back(argv[n]);
+	return !options.inputs.empty() && options.wordsPerMinute > 0 && options.sampleRate > 0
+		&& options.blockSize > 0 && options.jitterMs >= 0 && options.holdMs >= 0 && options.hitMs >= 0 && options.burstMs > 0;
+}
+
+// One character per line, each followed by ';', commas escaped as in Pd
+static bool loadKeylist(const std::string& path, std::map<std::string, unsigned int>& keys)
+{
+	std::ifstream file(path);
+	if(!file) {
+		fprintf(stderr, "Error: cannot open %s\n", path.c_str());
+		return false;
+	}
+	std::string line;
+	unsigned int index = 0;
+	while(std::getline(file, line)) {
+		line.erase(0, line.find_first_not_of(" \t\r"));
+		line.erase(line.find_last_not_of(" \t\r;") + 1);
+		if(line.empty())
+			continue;
+		if(line[0] == '\\')
+			line.erase(0, 1);
+		keys[line] = index++;
+	}
+	return !keys.empty();
+}
+
+// The characters of the keylist that have a capital in the text
+static const char* const kCapitals[][2] = {
+	{ "\xc3\x85", "\xc3\xa5" }, // Å å
+	{ "\xc3\x84", "\xc3\xa4" }, // Ä ä
+	{ "\xc3\x96", "\xc3\xb6" }, // Ö ö
+};
+
+static int lookUpKey(std::string character, const std::map<std::string, unsigned int>& keys)
+{
+	if(character.size() == 1)
+		character[0] = tolower(character[0]);
+	for(auto& pair : kCapitals)
+		if(character == pair[0])
+			character = pair[1];
+	auto it = keys.find(character);
+	return it == keys.end() ? -1 : (int)it->second;
+}
+
+static bool typeDocument(const RenderOptions& options, const std::map<std::string, unsigned int>& keys,
+		unsigned int seed, Document& doc)
+{
+	std::ifstream file(doc.inputPath, std::ios::binary);
+	if(!file) {
+		fprintf(stderr, "Error: cannot open %s\n", doc.inputPath.c_str());
+		return false;
+	}
+	std::stringstream contents;
+	contents << file.rdbuf();
+	const std::string text = contents.str();
+
+	const double framesPerMs = options.sampleRate / 1000.0;
+	const double strokeMs = 60000.0 / (options.wordsPerMinute * 5);
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<double> jitter(-options.jitterMs, options.jitterMs);
+
+	double timeMs = 100;
+	for(size_t n = 0; n < text.size(); ) {
+		// one UTF-8 character
+		const unsigned char lead = text[n];
+		size_t length = lead < 0x80 ? 1 : lead < 0xe0 ? 2 : lead < 0xf0 ? 3 : 4;
+		const std::string character = text.substr(n, length);
+		n += length;
+
+		if(character == "\r")
+			continue;
+		if(character == "\n") {
+			timeMs += options.newlineMs;
+			continue;
+		}
+		const int key = lookUpKey(character, keys);
+		if(key >= 0) {
+			const double pressMs = std::max(0.0, timeMs + jitter(random));
+			const uint64_t press = pressMs * framesPerMs;
+			doc.events.push_back({ press, KeyEvent::kPress, (unsigned int)key });
+			doc.events.push_back({ press + (uint64_t)(options.hitMs * framesPerMs), KeyEvent::kHit, (unsigned int)key });
+			doc.events.push_back({ press + (uint64_t)(options.holdMs * framesPerMs), KeyEvent::kRelease, (unsigned int)key });
+		} else if(character != " " && character != "\t") {
+			++doc.skipped;
+			continue;
+		}
+		timeMs += strokeMs;
+	}
+	std::stable_sort(doc.events.begin(), doc.events.end(),
+			[](const KeyEvent& a, const KeyEvent& b) { return a.frame < b.frame; });
+	doc.lengthFrames = (timeMs + options.holdMs) * framesPerMs + options.tailSec * options.sampleRate;
+	return true;
+}
+
+static void writeWavHeader(FILE* f, unsigned int sampleRate, uint32_t numFrames)
+{
+	const uint16_t channels = 2;
+	const uint16_t bits = 32;
+	const uint16_t format = 3; // IEEE float
+	const uint32_t dataBytes = numFrames * channels * bits / 8;
+	const uint32_t riffBytes = 36 + dataBytes;
+	const uint32_t fmtBytes = 16;
+	const uint32_t byteRate = sampleRate * channels * bits / 8;
+	const uint16_t blockAlign = channels * bits / 8;
+	fwrite("RIFF", 1, 4, f);
+	fwrite(&riffBytes, 4, 1, f);
+	fwrite("WAVEfmt ", 1, 8, f);
+	fwrite(&fmtBytes, 4, 1, f);
+	fwrite(&format, 2, 1, f);
+	fwrite(&channels, 2, 1, f);
+	fwrite(&sampleRate, 4, 1, f);
+	fwrite(&byteRate, 4, 1, f);
+	fwrite(&blockAlign, 2, 1, f);
+	fwrite(&bits, 2, 1, f);
+	fwrite("data", 1, 4, f);
+	fwrite(&dataBytes, 4, 1, f);
+}
+
+struct Receivers {
+	hv_uint32_t keyStatus = hv_stringToHash("keystatus");
+	hv_uint32_t hit = hv_stringToHash("nedslag1");
+	hv_uint32_t hitVelocity = hv_stringToHash("nedslag1vel");
+	hv_uint32_t tremoloRate = hv_stringToHash("tremoloRate");
+};
+
+static void sendHook(HeavyContextInterface* context, const char* name, hv_uint32_t hash, const HvMessage* m)
+{
+	static const Receivers receivers;
+	if(hash == receivers.tremoloRate)
+		((Tremolo*)hv_getUserData(context))->setRate(hv_msg_getFloat(m, 0));
+}
+
+static bool renderDocument(const RenderOptions& options, const TableBlob* tables, unsigned int seed, Document& doc)
+{
+	const Receivers receivers;
+	const unsigned int blockSize = options.blockSize;
+	HeavyContextInterface* context = hv_bela_new_with_options(options.sampleRate, 1000, 200, 0);
+	if(tables)
+		tables->bind(context);
+	Tremolo tremolo;
+	tremolo.setup(options.sampleRate, 4.0, 0.5); // as gTremoloRate in render.cpp
+	hv_setUserData(context, &tremolo);
+	hv_setSendHook(context, sendHook);
+
+	const unsigned int inputs = hv_getNumInputChannels(context);
+	const unsigned int outputs = hv_getNumOutputChannels(context);
+	std::vector<float> in(std::max(1u, inputs) * blockSize);
+	std::vector<float> out(std::max(2u, outputs) * blockSize);
+	std::vector<float> gain(blockSize);
+	std::vector<float> interleaved(2 * blockSize);
+
+	FILE* f = fopen(doc.outputPath.c_str(), "wb");
+	if(!f) {
+		fprintf(stderr, "Error: cannot write %s\n", doc.outputPath.c_str());
+		hv_delete(context);
+		return false;
+	}
+	const uint64_t numBlocks = (doc.lengthFrames + blockSize - 1) / blockSize;
+	writeWavHeader(f, options.sampleRate, numBlocks * blockSize);
+
+	const double msPerFrame = 1000.0 / options.sampleRate;
+	const float burstDecay = powf(0.001f, 1.f / (options.burstMs / msPerFrame));
+	std::minstd_rand noise(seed);
+	std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+	float burst = 0;
+	size_t next = 0;
+	size_t nextHit = 0;
+	for(uint64_t b = 0; b < numBlocks; ++b) {
+		const uint64_t start = b * blockSize;
+		for(unsigned int n = 0; n < blockSize; ++n) {
+			for(; nextHit < doc.events.size() && doc.events[nextHit].frame <= start + n; ++nextHit)
+				if(doc.events[nextHit].type == KeyEvent::kHit)
+					burst = options.burstLevel * options.velocity;
+			const float x = burst * uniform(noise);
+			burst *= burstDecay;
+			for(unsigned int ch = 0; ch < inputs; ++ch)
+				in[ch * blockSize + n] = x;
+		}
+		for(; next < doc.events.size() && doc.events[next].frame < start + blockSize; ++next) {
+			const KeyEvent& e = doc.events[next];
+			// the half frame as in render.cpp, so Heavy does not round down
+			const double delayMs = (e.frame - start + 0.5) * msPerFrame;
+			if(e.type == KeyEvent::kHit) {
+				hv_sendMessageToReceiverV(context, receivers.hitVelocity, delayMs, "f", options.velocity);
+				hv_sendMessageToReceiverV(context, receivers.hit, delayMs, "b");
+			} else {
+				hv_sendMessageToReceiverV(context, receivers.keyStatus, delayMs, "ff",
+						(float)e.key, e.type == KeyEvent::kPress ? 1.f : 0.f);
+			}
+		}
+		hv_processInline(context, in.data(), out.data(), blockSize);
+		tremolo.process(gain.data(), blockSize);
+		for(unsigned int n = 0; n < blockSize; ++n) {
+			interleaved[2 * n] = out[n] * gain[n];
+			interleaved[2 * n + 1] = out[(outputs > 1) * blockSize + n] * gain[n];
+		}
+		fwrite(interleaved.data(), sizeof(float), interleaved.size(), f);
+	}
+	bool ok = !ferror(f);
+	ok = (fclose(f) == 0) && ok;
+	hv_delete(context);
+	return ok;
+}
+
+static std::string outputPathFor(const RenderOptions& options, const std::string& input)
+{
+	size_t slash = input.find_last_of('/');
+	std::string name = input.substr(slash == std::string::npos ? 0 : slash + 1);
+	size_t dot = name.find_last_of('.');
+	if(dot != std::string::npos && dot > 0)
+		name.resize(dot);
+	return options.outputDir + "/" + name + ".wav";
+}
+
+static double nowSec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char** argv)
+{
+	RenderOptions options;
+	if(!parseOptions(argc, argv, options)) {
+		usage(argv[0]);
+		return 1;
+	}
+	std::map<std::string, unsigned int> keys;
+	if(!loadKeylist(options.keylistPath, keys))
+		return 1;
+	TableBlob tables;
+	if(!options.tablesPath.empty() && !tables.open(options.tablesPath.c_str()))
+		return 1;
+
+	std::vector<Document> docs(options.inputs.size());
+	for(unsigned int n = 0; n < docs.size(); ++n) {
+		docs[n].inputPath = options.inputs[n];
+		docs[n].outputPath = outputPathFor(options, options.inputs[n]);
+	}
+	unsigned int numThreads = options.threads ? options.threads : std::thread::hardware_concurrency();
+	numThreads = std::max(1u, std::min(numThreads, (unsigned int)docs.size()));
+
+	const double start = nowSec();
+	std::atomic<unsigned int> nextDoc { 0 };
+	auto worker = [&]() {
+		for(unsigned int n; (n = nextDoc++) < docs.size(); ) {
+			Document& doc = docs[n];
+			const double docStart = nowSec();
+			doc.ok = typeDocument(options, keys, options.seed + n, doc)
+				&& renderDocument(options, tables.isOpen() ? &tables : nullptr, options.seed + n, doc);
+			doc.seconds = nowSec() - docStart;
+		}
+	};
+	std::vector<std::thread> threads;
+	for(unsigned int n = 0; n < numThreads; ++n)
+		threads.emplace_back(worker);
+	for(auto& t : threads)
+		t.join();
+	const double elapsed = nowSec() - start;
+
+	int ret = 0;
+	double audioSec = 0;
+	printf("# %8s %8s %8s %8s  %s\n", "keys", "skipped", "audio s", "x rt", "output");
+	for(auto& doc : docs) {
+		if(!doc.ok) {
+			printf("  failed: %s\n", doc.inputPath.c_str());
+			ret = 1;
+			continue;
+		}
+		const double sec = doc.lengthFrames / options.sampleRate;
+		audioSec += sec;
+		printf("  %8zu %8u %8.1f %8.1f  %s\n", doc.events.size() / 3, doc.skipped, sec,
+				sec / doc.seconds, doc.outputPath.c_str());
+	}
+	printf("# %.1f s of audio in %.2f s on %u threads, %.1f x real time\n",
+			audioSec, elapsed, numThreads, audioSec / elapsed);
+	return ret;
+}
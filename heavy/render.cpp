@@ -32,6 +32,24 @@ The Bela software is distributed under the GNU Lesser General Public License
 #include <algorithm>
 #include <array>
 #include <vector>
+#include "KeyScanner.h"
+#include "HitDetector.h"
+#include "ChannelRouting.h"
+#include "Tremolo.h"
+#include "TableBlob.h"
+#include "TableBank.h"
+#include "ControlQueue.h"
+#include "StageProfiler.h"
+#include "EventLog.h"
+#include "VoiceAllocator.h"
+#include "MemoryArena.h"
+#include "HeavyPools.h"
+#include "DeadlineWatchdog.h"
+#include "ScopeCapture.h"
+#include "MultiplexerInput.h"
+#include <new>
+#include <sys/stat.h>
+#include <unistd.h>
 //#include <io
 
 #define BELA_HV_SCOPE
@@ -40,6 +58,21 @@ The Bela software is distributed under the GNU Lesser General Public License
 #undef BELA_HV_SCOPE
 #endif // BELA_HV_DISABLE_SCOPE
 
+#define BELA_HV_PROFILE
+
+#ifdef BELA_HV_DISABLE_PROFILE
+#undef BELA_HV_PROFILE
+#endif // BELA_HV_DISABLE_PROFILE
+
+#define BELA_HV_IDLE_BYPASS
+
+#ifdef BELA_HV_DISABLE_IDLE_BYPASS
+#undef BELA_HV_IDLE_BYPASS
+#endif // BELA_HV_DISABLE_IDLE_BYPASS
+
+// Off until the patch has something to give up under load, see the quality
+// ladder. Define BELA_HV_WATCHDOG to try it anyway.
+
 /*
  *  MODIFICATION
  *  ------------
@@ -47,28 +80,359 @@ The Bela software is distributed under the GNU Lesser General Public License
  */
 
 float gTremoloRate = 4.0;
-float gPhase;
+static Tremolo gTremolo;
+float* gTremoloGain = NULL; // one gain per audio frame
+
+/*
+ *  MODIFICATION
+ *  ------------
+ *  Memory. The buffers render() works on, the messages it sends and the
+ *  scope come from gArena, sized in setup() once the channel counts are
+ *  known and locked there. The end of setup() locks the rest of the
+ *  process, Heavy's delay lines and pools included, and prints what it all
+ *  comes to.
+ */
+
+static MemoryArena gArena;
+
+/*
+ *  MODIFICATION
+ *  ------------
+ *  Voicing tables. If the project has a tables.bin (make tables in host/),
+ *  its tables replace the ones exported with the patch. While playing, an
+ *  auxiliary task checks the file every kTableWatchMs and stages a changed
+ *  one, which render() swaps in at the start of the next block.
+ */
 
-bool gSensorIn [6][8];
-bool gSensorOut [6][8];
-int gSensorDeb [6][8];
-bool gXSensorIn [8];
-bool gXSensorOut [8];
+enum { kTableWatchMs = 500 };
+
+const char* gTableBlobPath = "tables.bin";
+static TableBlob gTableBlob;
+static TableBank gTableBank;
+static AuxiliaryTask gTableWatchTask;
+static unsigned int gTableWatchBlocks;
+static struct stat gTableBlobStat; // of the last tables.bin looked at
+
+static bool tableBlobChanged()
+{
+	struct stat st;
+	if(stat(gTableBlobPath, &st))
+		return false;
+	bool changed = st.st_size != gTableBlobStat.st_size
+		|| st.st_mtim.tv_sec != gTableBlobStat.st_mtim.tv_sec
+		|| st.st_mtim.tv_nsec != gTableBlobStat.st_mtim.tv_nsec;
+	gTableBlobStat = st;
+	return changed;
+}
+
+static void watchTableBlob(void*)
+{
+	if(gTableBank.isStaged() || !tableBlobChanged())
+		return;
+	TableBlob blob;
+	if(blob.open(gTableBlobPath) && gTableBank.stage(blob))
+		printf("Swapping in the tables from %s\n", gTableBlobPath);
+}
+
+/*
+ *  MODIFICATION
+ *  ------------
+ *  Key matrix and X-keys. Digital frame n drives address n & 7 on pins 0-2,
+ *  the six rows come back active low on pins 3-8 and the X-key for the same
+ *  address on pin 15. Key (m, n) is sent to keystatus as m * 8 + n, the last
+ *  row only has four keys. Every group of eight digital frames is a complete
+ *  scan, and each transition is timestamped with the frame it was seen in.
+ */
+
+enum {
+	kKeyMatrixFirstRowPin = 3,
+	kKeyMatrixRows = 6,
+	kKeyMatrixColumns = 8,
+	kKeyMatrixKeys = 44,
+	kKeyDebounceFrames = 4096, // 256 blocks of 16 frames, ~93 ms at 44.1 kHz
+	kXKeyPin = 15,
+};
+
+static KeyScanner gKeyMatrix;
+static KeyScanner gXKeys;
 bool gXSensorActive [8] = {true, true, true, true, true, true, true, true};
 bool gXSensorInverted [8] = {true, false, false, false, false, false, false, false};
-int gXSensorDeb [8];
-int gHitDeb = 0;
-// float gHitSensor;
+static uint32_t gXSensorInvertedMask;
+
+// The address lines as whole digital words, built once in setup(): frame n
+// of the block gets gAddressWords[n & 7] in the bits of gAddressMask.
+enum { kDigitalValueShift = 16 };
+static uint32_t gAddressWords[kKeyMatrixColumns];
+static uint32_t gAddressMask;
+
+static void buildAddressWords()
+{
+	gAddressMask = 0;
+	for(unsigned int n = 0; n < kKeyMatrixColumns; ++n) {
+		// pin 0 carries the high bit of the address, pin 2 the low one
+		gAddressWords[n] = ((n >> 2 & 1) << (kDigitalValueShift + 0)) | ((n >> 1 & 1) << (kDigitalValueShift + 1))
+				| ((n & 1) << (kDigitalValueShift + 2));
+		gAddressMask |= gAddressWords[n];
+	}
+}
+
+static void writeAddress(BelaContext *context)
+{
+	uint32_t* digital = context->digital;
+	for(unsigned int n = 0; n < context->digitalFrames; ++n)
+		digital[n] = (digital[n] & ~gAddressMask) | gAddressWords[n & (kKeyMatrixColumns - 1)];
+}
+
+/*
+ *  MODIFICATION
+ *  ------------
+ *  Hit sensor on the type bar. Each hit sends its velocity to nedslag1vel
+ *  followed by a bang to nedslag1, both timestamped with the frame of the
+ *  onset.
+ */
+
+enum { kMaxHitsPerBlock = 4 };
+static HitDetector gHitDetector;
 
 int gAudioFramesPerAnalogFrame = 0;
 int gHitSensorChannel = 0;
 
+/*
+ *  MODIFICATION
+ *  ------------
+ *  Event recording and playback. With gEventRecordPath set, every key,
+ *  X-key and hit event is also written to that file. With gEventReplayPath
+ *  set, the events in that file are played, over and over, instead of
+ *  reading the key matrix, X-keys and hit sensor. Both are NULL for playing
+ *  the instrument.
+ */
+
+enum { kEventFlushMs = 1000 };
+
+const char* gEventRecordPath = NULL;
+const char* gEventReplayPath = NULL;
+static EventRecorder gEventRecorder;
+static EventReplayer gEventReplayer;
+static AuxiliaryTask gEventFlushTask;
+static unsigned int gEventFlushBlocks;
+static uint64_t gBlockStartFrame;
+
+static void flushEvents(void*)
+{
+	gEventRecorder.flush();
+}
+
+/*
+ *  MODIFICATION
+ *  ------------
+ *  Control messages from outside the audio thread. An auxiliary task pushes
+ *  into gControlQueue, render() passes up to kControlMessagesPerBlock of
+ *  them to Heavy before processing each block.
+ */
+
+enum {
+	kControlQueueSize = 256,
+	kControlMessagesPerBlock = 32,
+	kControlMessagesUnderLoad = 8, // see the quality ladder
+};
+
+ControlQueue gControlQueue;
+
+/*
+ *  MODIFICATION
+ *  ------------
+ *  Sizes of Heavy's message pool and input queue. setup() reads them from
+ *  gHeavySizesPath if it exists, and falls back to the generous defaults
+ *  otherwise. gHeavyPools follows how much of each the patch uses, and
+ *  gHeavyPoolsTask warns as soon as either comes close to its capacity.
+ *  With gHeavySizing set, the defaults are used whatever the file says, and
+ *  cleanup() writes back what the run needed, with margin, keeping the
+ *  larger of that and what was already there so that several runs add up.
+ */
+
+enum {
+	kHeavyPoolKb = 1000,
+	kHeavyInQueueKb = 200,
+};
+
+const char* gHeavySizesPath = "heavy-sizes.txt";
+bool gHeavySizing = false;
+static HeavyPools gHeavyPools;
+static AuxiliaryTask gHeavyPoolsTask;
+
+static void printPoolUsage(FILE* f)
+{
+	const HeavyPools::Usage usage = gHeavyPools.getUsage();
+	fprintf(f, "Heavy message pool: %zu of %zu bytes, input queue: %zu of %zu bytes\n", usage.poolBytes,
+			usage.poolCapacity, usage.inQueueBytes, usage.inQueueCapacity);
+	if(usage.sendFailures)
+		fprintf(f, "Messages Heavy had no room for: %llu\n", (unsigned long long)usage.sendFailures);
+}
+
+// Reported once
+static void warnHeavyPools(void*)
+{
+	static bool reported = false;
+	if(reported || !gHeavyPools.isNearlyFull())
+		return;
+	reported = true;
+	fprintf(stderr, "Warning: Heavy is running out of room, give it larger sizes in %s\n",
+			gHeavySizesPath ? gHeavySizesPath : "the sizes file");
+	printPoolUsage(stderr);
+}
+
+/*
+ *  MODIFICATION
+ *  ------------
+ *  Voices and idle bypass. gVoices follows the [poly 3 1] in the patch, so
+ *  render() knows when none of the three voices can still be heard. From
+ *  then on, once the audio inputs and Heavy's outputs have also stayed under
+ *  kIdleLevel for kIdleHoldMs, a block would only filter silence: Heavy is
+ *  skipped and its outputs are left at zero until an event, a control
+ *  message or input above kIdleLevel wakes it up. kIdleHoldMs covers the
+ *  transposition delay lines in filters~, so those only hold silence by the
+ *  time Heavy stops. Heavy's clock stands still while it is skipped, so
+ *  hv_getCurrentSample() falls behind context->audioFramesElapsed by every
+ *  skipped block: anything that compares the two, like the bench's latency
+ *  report, has to count frames from the host instead. The events render()
+ *  sends are scheduled relative to Heavy's clock and still land on the
+ *  right frame, and the patch schedules nothing itself that outlasts a
+ *  voice. Build with BELA_HV_DISABLE_IDLE_BYPASS to process every block.
+ */
+
+enum {
+	kNumVoices = 3, // [poly 3 1]
+	kVoiceTailMs = 1500,
+	kIdleHoldMs = 1500,
+};
+
+static const float kIdleLevel = 0.0001f; // -80 dBFS
+
+static VoiceAllocator gVoices;
+#ifdef BELA_HV_IDLE_BYPASS
+static uint64_t gIdleHoldFrames;
+static uint64_t gLastSoundFrame; // end of the last block in or out above kIdleLevel
+static bool gHeavyPending; // messages sent to Heavy since it last processed a block
+static bool gHeavyIdle;
+static uint64_t gIdleBlocks;
+
+static float peakLevel(const float* samples, unsigned int numSamples)
+{
+	float peak = 0;
+	for(unsigned int n = 0; n < numSamples; ++n)
+		peak = std::max(peak, fabsf(samples[n]));
+	return peak;
+}
+#endif // BELA_HV_IDLE_BYPASS
+
+/*
+ *  MODIFICATION
+ *  ------------
+ *  Quality ladder. gWatchdog times every render() against the block and,
+ *  once the first kWatchdogWarmupMs are over, steps up the ladder under
+ *  load sustained for about kWatchdogDegradeMs, and back down after
+ *  kWatchdogRecoverMs of quiet. A lone overrun does not move it. Heavy
+ *  runs every voice and every effect of the patch on each block whether
+ *  they can be heard or not, so what can be given up is around it:
+ *
+ *  kQualityLight        the scope stops capturing, and control messages are
+ *                       passed on kControlMessagesUnderLoad per block
+ *
+ *  Every key is always played: leaving keys out saves none of Heavy's
+ *  time, so there is no rung for it until one that does, such as a
+ *  patch with fewer voices, exists.
+ *
+ *  With this export kQualityLight saves nothing either: the patch has no
+ *  outputs past the four audio ones, so there are no scope channels, and
+ *  nothing pushes to gControlQueue yet. Timing every block to reach it is
+ *  pure cost, so the watchdog is only built with BELA_HV_WATCHDOG, and
+ *  render() stays at kQualityFull otherwise.
+ */
+
+enum QualityLevel {
+	kQualityFull,
+	kQualityLight,
+	kNumQualityLevels,
+};
+
+enum {
+	kWatchdogWarmupMs = 500, // cold caches and first page faults
+	kWatchdogDegradeMs = 50,
+	kWatchdogRecoverMs = 3000,
+};
+
+#ifdef BELA_HV_WATCHDOG
+static DeadlineWatchdog gWatchdog;
+
+static inline unsigned int qualityLevel()
+{
+	return gWatchdog.getLevel();
+}
+#else
+static inline unsigned int qualityLevel()
+{
+	return kQualityFull;
+}
+#endif // BELA_HV_WATCHDOG
+
+/*
+ *  MODIFICATION
+ *  ------------
+ *  Time spent in each stage of render(), printed by an auxiliary task every
+ *  kProfileWindowMs. Build with BELA_HV_DISABLE_PROFILE to leave it out.
+ */
+
+#ifdef BELA_HV_PROFILE
+enum {
+	kProfileWindowMs = 5000,
+};
+
+enum ProfileStage {
+	kStageControl,
+	kStageDeinterleave,
+	kStageMultiplexer,
+	kStageDigitalIn,
+	kStageHeavy,
+	kStageDigitalOut,
+	kStageScope,
+	kStageTremolo,
+	kStageKeys,
+	kStageHits,
+	kStageInterleave,
+	kNumProfileStages
+};
+
+static const char* const gProfileStageNames[kNumProfileStages] = {
+	"control", "deinterleave", "multiplexer", "digital in", "heavy", "digital out",
+	"scope", "tremolo", "keys", "hits", "interleave",
+};
+
+static StageProfiler gProfiler;
+static AuxiliaryTask gProfileTask;
+
+static void printProfile(void*)
+{
+	static StageProfiler::Snapshot snapshot;
+	if(gProfiler.read(snapshot))
+		gProfiler.print(snapshot);
+}
+
+#define PROFILE_BEGIN() gProfiler.beginBlock()
+#define PROFILE_STAGE(stage) gProfiler.endStage(stage)
+#define PROFILE_END() do { if(gProfiler.endBlock()) Bela_scheduleAuxiliaryTask(gProfileTask); } while(0)
+#else
+#define PROFILE_BEGIN()
+#define PROFILE_STAGE(stage)
+#define PROFILE_END()
+#endif // BELA_HV_PROFILE
+
 /*********/
 
 enum { minFirstDigitalChannel = 10 };
 
 static unsigned int gAudioChannelsInUse;
 static unsigned int gAnalogChannelsInUse;
+static ChannelRouting gChannelRouting;
 static unsigned int gDigitalChannelsInUse;
 static unsigned int gChannelsInUse;
 static unsigned int gFirstAnalogChannel;
@@ -77,18 +441,80 @@ static unsigned int gDigitalChannelOffset;
 
 static unsigned int gDigitalSigInChannelsInUse;
 static unsigned int gDigitalSigOutChannelsInUse;
+// channels dcm handles as signal-rate outputs, updated by bela_setDigital
+static uint32_t gDigitalSigOutMask;
 
 static unsigned int gFirstScopeChannel;
 unsigned int gScopeChannelsInUse;
 #ifdef BELA_HV_SCOPE
 #include <libraries/Scope/Scope.h>
 // Bela Scope
-float* gScopeOut;
+/*
+ *  MODIFICATION
+ *  ------------
+ *  Scope capture. render() only copies every gScopeDecimation-th frame of
+ *  the scope channels into gScopeCapture, and gScopeTask logs them to the
+ *  Scope kScopeBatchFrames at a time. gScopeTrigger picks what is logged:
+ *  everything, or gScopePreMs before and gScopePostMs after each key
+ *  press, each hit, or each rise of scope channel gScopeTriggerChannel
+ *  through gScopeTriggerLevel. Key presses and hits trigger at the frame
+ *  they are heard from, a block after they were read.
+ */
+
+enum ScopeTrigger {
+	kScopeFreeRun,
+	kScopeOnKey,
+	kScopeOnHit,
+	kScopeOnLevel,
+};
+
+enum { kScopeBatchFrames = 256 };
+
+ScopeTrigger gScopeTrigger = kScopeFreeRun;
+unsigned int gScopeDecimation = 1;
+unsigned int gScopePreMs = 20;
+unsigned int gScopePostMs = 200;
+unsigned int gScopeTriggerChannel = 0;
+float gScopeTriggerLevel = 0.5f;
+float* gScopeBatch;
 static Scope* scope = NULL;
+static ScopeCapture gScopeCapture;
+static AuxiliaryTask gScopeTask;
+
+static void logScope(void*)
+{
+	int triggerIndex;
+	unsigned int numFrames;
+	while((numFrames = gScopeCapture.read(gScopeBatch, kScopeBatchFrames, triggerIndex))) {
+		for(unsigned int n = 0; n < numFrames; ++n) {
+			if((int)n == triggerIndex)
+				scope->trigger();
+			scope->log(gScopeBatch + n * gScopeCapture.getNumChannels());
+		}
+	}
+}
 #endif // BELA_HV_SCOPE
 static char multiplexerArray[] = {"bela_multiplexer"};
 static int multiplexerArraySize = 0;
 static bool pdMultiplexerActive = false;
+
+/*
+ *  MODIFICATION
+ *  ------------
+ *  Multiplexer. gMultiplexer writes the multiplexer channels the hardware
+ *  refreshed in this block into bela_multiplexer, smoothed over
+ *  gMultiplexerSmoothingMs, before Heavy processes the block. With
+ *  gMultiplexerNotify set, a slot that moves by more than
+ *  gMultiplexerThreshold is also sent to bela_multiplexerChanged as
+ *  [slot value(, at the frame it was read in. The patch as exported has no
+ *  [r bela_multiplexerChanged], so for now these messages are ignored.
+ */
+
+float gMultiplexerSmoothingMs = 10;
+float gMultiplexerThreshold = 0.005f;
+bool gMultiplexerNotify = false;
+static MultiplexerInput gMultiplexer;
+
 bool gDigitalEnabled = 0;
 
 /*
@@ -100,7 +526,171 @@ float *gHvInputBuffers = NULL, *gHvOutputBuffers = NULL;
 unsigned int gHvInputChannels = 0, gHvOutputChannels = 0;
 uint32_t multiplexerTableHash;
 
-float gInverseSampleRate;
+/*
+ *	RECEIVERS
+ *	Hashed once in setup(), so that nothing on the audio thread touches a
+ *	string. Key events go out through messages allocated in setup() as well.
+ */
+
+struct HeavyReceiver {
+	const char* name;
+	hv_uint32_t hash;
+};
+
+enum {
+	kReceiverKeyStatus,
+	kReceiverXKeyStatus,
+	kReceiverHit,
+	kReceiverHitVelocity,
+	kReceiverMultiplexerChannels,
+	kReceiverMultiplexerChanged,
+	kNumReceivers,
+};
+
+static HeavyReceiver gReceivers[kNumReceivers] = {
+	{ "keystatus", 0 },
+	{ "xkeystatus", 0 },
+	{ "nedslag1", 0 },
+	{ "nedslag1vel", 0 },
+	{ "bela_multiplexerChannels", 0 },
+	{ "bela_multiplexerChanged", 0 },
+};
+
+static HvMessage* gKeyMessage; // [index state(
+static HvMessage* gFloatMessage;
+static HvMessage* gBangMessage;
+static HvMessage* gMultiplexerMessage; // [slot value(
+static double gMsPerFrame;
+
+// Events are scheduled after hv_processInline(), so frame n of this block
+// lands on frame n of the next one and every event has the same latency.
+// The half frame keeps Heavy's conversion back to samples from rounding
+// down to the previous frame.
+static inline double frameToDelayMs(unsigned int frame)
+{
+	return (frame + 0.5) * gMsPerFrame;
+}
+
+static void hashReceivers()
+{
+	for(unsigned int n = 0; n < kNumReceivers; ++n)
+		gReceivers[n].hash = hv_stringToHash(gReceivers[n].name);
+}
+
+static void sendKeyMessage(unsigned int receiver, unsigned int index, float state, unsigned int frame)
+{
+	hv_msg_setFloat(gKeyMessage, 0, (float) index);
+	hv_msg_setFloat(gKeyMessage, 1, state);
+	if(!hv_sendMessageToReceiver(gHeavyContext, gReceivers[receiver].hash, frameToDelayMs(frame), gKeyMessage))
+		gHeavyPools.sendFailed();
+}
+
+static void sendFloatMessage(unsigned int receiver, float value, unsigned int frame)
+{
+	hv_msg_setFloat(gFloatMessage, 0, value);
+	if(!hv_sendMessageToReceiver(gHeavyContext, gReceivers[receiver].hash, frameToDelayMs(frame), gFloatMessage))
+		gHeavyPools.sendFailed();
+}
+
+static void sendBangMessage(unsigned int receiver, unsigned int frame)
+{
+	if(!hv_sendMessageToReceiver(gHeavyContext, gReceivers[receiver].hash, frameToDelayMs(frame), gBangMessage))
+		gHeavyPools.sendFailed();
+}
+
+static void sendMultiplexerChange(const MultiplexerInput::Change& change, unsigned int frame)
+{
+	hv_msg_setFloat(gMultiplexerMessage, 0, (float) change.slot);
+	hv_msg_setFloat(gMultiplexerMessage, 1, change.value);
+	if(!hv_sendMessageToReceiver(gHeavyContext, gReceivers[kReceiverMultiplexerChanged].hash, frameToDelayMs(frame),
+			gMultiplexerMessage))
+		gHeavyPools.sendFailed();
+}
+
+// Sends a sensor event to the patch, and to the recording if there is one
+static void dispatchEvent(EventLog::Type type, unsigned int index, float value, unsigned int frame)
+{
+	switch(type) {
+		case EventLog::kKey:
+#ifdef BELA_HV_SCOPE
+			if(value && gScopeTrigger == kScopeOnKey)
+				gScopeCapture.trigger(frame);
+#endif // BELA_HV_SCOPE
+			sendKeyMessage(kReceiverKeyStatus, index, value, frame);
+			if(value)
+				gVoices.noteOn(index, gBlockStartFrame + frame);
+			else
+				gVoices.noteOff(index, gBlockStartFrame + frame);
+			break;
+		case EventLog::kXKey:
+			sendKeyMessage(kReceiverXKeyStatus, index, value, frame);
+			break;
+		case EventLog::kHit:
+#ifdef BELA_HV_SCOPE
+			if(gScopeTrigger == kScopeOnHit)
+				gScopeCapture.trigger(frame);
+#endif // BELA_HV_SCOPE
+			// the patch routes the nedslag1 bang through [spigot] and [f] to the
+			// voice of the last key pressed; it has no nedslag1vel receiver
+			sendFloatMessage(kReceiverHitVelocity, value, frame);
+			sendBangMessage(kReceiverHit, frame);
+			break;
+	}
+	gEventRecorder.record(type, index, value, gBlockStartFrame + frame);
+#ifdef BELA_HV_IDLE_BYPASS
+	gHeavyPending = true;
+#endif // BELA_HV_IDLE_BYPASS
+}
+
+// Scan the key matrix and the X-keys, only keys that changed are visited.
+// Key (m, n) and X-key n are read in frame n of each scan.
+static void scanKeys(BelaContext *context)
+{
+	const unsigned int framesPerScan = std::min(context->digitalFrames, (unsigned int)kKeyMatrixColumns);
+	for(unsigned int scan = 0; framesPerScan && scan + framesPerScan <= context->digitalFrames; scan += framesPerScan) {
+		const uint32_t* digital = context->digital + scan;
+		uint64_t pressed, released;
+		gKeyMatrix.process(KeyScanner::packMatrix(digital, framesPerScan, kKeyMatrixFirstRowPin, kKeyMatrixRows),
+				pressed, released);
+		for(uint64_t k = pressed; k; k = KeyScanner::clearLowest(k)) {
+			unsigned int key = KeyScanner::lowest(k);
+			dispatchEvent(EventLog::kKey, key, 1.0f, scan + key % kKeyMatrixColumns);
+		}
+		for(uint64_t k = released; k; k = KeyScanner::clearLowest(k)) {
+			unsigned int key = KeyScanner::lowest(k);
+			dispatchEvent(EventLog::kKey, key, 0.0f, scan + key % kKeyMatrixColumns);
+		}
+
+		// inverted X-keys read high when pressed, the others low
+		uint32_t xLevels = KeyScanner::packColumn(digital, framesPerScan, kXKeyPin);
+		uint32_t xInput = (xLevels ^ ~gXSensorInvertedMask) & ((1u << framesPerScan) - 1);
+		gXKeys.process(xInput, pressed, released);
+		for(uint64_t k = pressed; k; k = KeyScanner::clearLowest(k))
+			dispatchEvent(EventLog::kXKey, KeyScanner::lowest(k), 1.0f, scan + KeyScanner::lowest(k));
+		for(uint64_t k = released; k; k = KeyScanner::clearLowest(k))
+			dispatchEvent(EventLog::kXKey, KeyScanner::lowest(k), 0.0f, scan + KeyScanner::lowest(k));
+	}
+}
+
+// Hit sensor onsets over the whole analog block
+static void scanHitSensor(BelaContext *context)
+{
+	if(!gAudioFramesPerAnalogFrame || (unsigned int)gHitSensorChannel >= context->analogInChannels)
+		return;
+	HitDetector::Onset hits[kMaxHitsPerBlock];
+	unsigned int numHits = gHitDetector.process(context->analogIn + gHitSensorChannel, context->analogFrames,
+			context->analogInChannels, hits, kMaxHitsPerBlock);
+	for(unsigned int h = 0; h < numHits; ++h)
+		dispatchEvent(EventLog::kHit, 0, hits[h].velocity, hits[h].frame * gAudioFramesPerAnalogFrame);
+}
+
+// Recorded events due in this block, in place of the sensors
+static void replayEvents(BelaContext *context)
+{
+	const uint64_t blockEnd = gBlockStartFrame + context->audioFrames;
+	for(const EventLog::Event* e; (e = gEventReplayer.next(gBlockStartFrame, blockEnd)); )
+		dispatchEvent((EventLog::Type)e->type, e->index, e->value, e->frame - gBlockStartFrame);
+}
 
 /*
  *	HEAVY FUNCTIONS
@@ -116,18 +706,30 @@ void printHook(HeavyContextInterface *context, const char *printLabel, const cha
 // digitals
 static DigitalChannelManager dcm;
 
-void sendDigitalMessage(bool state, unsigned int delay, void* receiverName){
-	hv_sendFloatToReceiver(gHeavyContext, hv_stringToHash((char*)receiverName), (float)state);
-//	rt_printf("%s: %d\n", (char*)receiverName, state);
+static void updateDigitalSigOutMask()
+{
+	gDigitalSigOutMask = 0;
+	for(unsigned int k = 0; k < gDigitalSigOutChannelsInUse; ++k)
+		if(dcm.isSignalRate(k) && dcm.isOutput(k))
+			gDigitalSigOutMask |= 1u << k;
+}
+
+void sendDigitalMessage(bool state, unsigned int delay, void* receiverHash){
+	hv_sendFloatToReceiver(gHeavyContext, *(hv_uint32_t*)receiverHash, (float)state);
+//	rt_printf("%x: %d\n", *(hv_uint32_t*)receiverHash, state);
 }
 
-std::vector<std::string> gHvDigitalInHashes;
-void generateDigitalNames(unsigned int numDigitals, unsigned int digitalOffset, std::vector<std::string>& receiverInputNames)
+std::vector<hv_uint32_t> gHvDigitalInHashes;
+std::vector<hv_uint32_t> gHvDigitalOutHashes;
+void generateDigitalHashes(unsigned int numDigitals, unsigned int digitalOffset,
+		std::vector<hv_uint32_t>& receiverInputHashes, std::vector<hv_uint32_t>& senderOutputHashes)
 {
-	std::string inBaseString = "bela_digitalIn";
+	receiverInputHashes.clear();
+	senderOutputHashes.clear();
 	for(unsigned int i = 0; i<numDigitals; i++)
 	{
-		receiverInputNames.push_back(inBaseString + std::to_string(i+digitalOffset));
+		receiverInputHashes.push_back(hv_stringToHash(("bela_digitalIn" + std::to_string(i+digitalOffset)).c_str()));
+		senderOutputHashes.push_back(hv_stringToHash(("bela_digitalOut" + std::to_string(i+digitalOffset)).c_str()));
 	}
 }
 
@@ -159,42 +761,19 @@ static void sendHook(
 	heavyPrintMsgTypes(m);
 	free(str);
 #endif
-	/*
-	 *  MODIFICATION
-	 *  ------------
-	 *  Parse float sent to receiver 'tremoloRate' and assign it to a global variable
-	 */
-
-	if(strncmp(receiverName, "tremoloRate", 11) == 0){
-		float value = hv_msg_getFloat(m, 0); // see the Heavy C API documentation: https://github.com/giuliomoro/hvcc/blob/master-bela/docs/06.cpp.md
-		gTremoloRate = value;
-	}
-
-	/*********/
-	// Bela digital run-time messages
-
-	// TODO: this first block is almost an exact copy of libpd's code, should we add this to the class?
-	// let's make this as optimized as possible for built-in digital Out parsing
-	// the built-in digital receivers are of the form "bela_digitalOutXX" where XX is between 11 and 26
-	static const int prefixLength = 15; // strlen("bela_digitalOut")
-	if(strncmp(receiverName, "bela_digitalOut", prefixLength)==0){
-		if(receiverName[prefixLength] != 0){ //the two ifs are used instead of if(strlen(source) >= prefixLength+2)
-			if(receiverName[prefixLength + 1] != 0){
-				// quickly convert the suffix to integer, assuming they are numbers, avoiding to call atoi
-				int receiver = ((receiverName[prefixLength] - '0') * 10);
-				receiver += (receiverName[prefixLength+1] - '0');
-				unsigned int channel = receiver - gDigitalChannelOffset; // go back to the actual Bela digital channel number
-				bool value = (hv_msg_getFloat(m, 0) != 0.0f);
-				if(channel < gDigitalChannelsInUse){ //gDigitalChannelsInUse is the number of digital channels
-					dcm.setValue(channel, value);
-				}
-			}
-		}
-		return;
-	}
-
 	// More MIDI and digital messages. To obtain the hashes below, use hv_stringToHash("yourString")
 	switch (sendHash) {
+		/*
+		 *  MODIFICATION
+		 *  ------------
+		 *  Parse float sent to receiver 'tremoloRate' and assign it to a global variable
+		 */
+		case 0x4A968EE7: { // tremoloRate
+			gTremoloRate = hv_msg_getFloat(m, 0); // see the Heavy C API documentation: https://github.com/giuliomoro/hvcc/blob/master-bela/docs/06.cpp.md
+			gTremolo.setRate(gTremoloRate);
+			break;
+		}
+		/*********/
 		case 0x70418732: { // bela_setDigital
 			if(gDigitalEnabled)
 			{
@@ -220,6 +799,7 @@ static void sendHook(
 				int channel = hv_msg_getFloat(m, 1) - gDigitalChannelOffset;
 				if(disable == true){
 					dcm.unmanage(channel);
+					updateDigitalSigOutMask();
 					return;
 				}
 				if(hv_msg_isSymbol(m, 2)){
@@ -229,10 +809,20 @@ static void sendHook(
 					}
 				}
 				dcm.manage(channel, direction, isMessageRate);
+				updateDigitalSigOutMask();
 			}
 			break;
 		}
 		default: {
+			// Bela digital run-time messages
+			// the built-in digital senders are of the form "bela_digitalOutXX" where XX is between 11 and 26,
+			// their hashes are generated in setup()
+			for(unsigned int channel = 0; channel < gHvDigitalOutHashes.size(); ++channel) {
+				if(gHvDigitalOutHashes[channel] == sendHash) {
+					dcm.setValue(channel, hv_msg_getFloat(m, 0) != 0.0f);
+					break;
+				}
+			}
 			break;
 		}
 	}
@@ -251,7 +841,7 @@ bool setup(BelaContext *context, void *userData)	{
 	 *  Initialise variables for tremolo effect
 	 */
 
-	gPhase = 0.0;
+	gTremolo.setup(context->audioSampleRate, gTremoloRate, 0.5);
 
     pinMode(context, 0, 0, OUTPUT); // Set gOutputPin as output
     pinMode(context, 0, 1, OUTPUT); // Set gOutputPin as output
@@ -269,9 +859,23 @@ bool setup(BelaContext *context, void *userData)	{
     pinMode(context, 0, 13, INPUT); // Set gOutputPin as input
     pinMode(context, 0, 14, INPUT); // Set gOutputPin as input l*/
     pinMode(context, 0, 15, INPUT); // Set gOutputPin as input
+
+    // one scan per eight digital frames, or one per block for smaller blocks
+    const unsigned int framesPerScan = std::max(1u, std::min(context->digitalFrames, (unsigned int)kKeyMatrixColumns));
+    gKeyMatrix.setup((1ull << kKeyMatrixKeys) - 1, kKeyDebounceFrames / framesPerScan);
+    buildAddressWords();
+    uint64_t xSensorActiveMask = 0;
+    gXSensorInvertedMask = 0;
+    for(unsigned int n = 0; n < kKeyMatrixColumns; ++n) {
+        xSensorActiveMask |= (uint64_t)gXSensorActive[n] << n;
+        gXSensorInvertedMask |= (uint32_t)gXSensorInverted[n] << n;
+    }
+    // the X-keys have never been debounced
+    gXKeys.setup(xSensorActiveMask, 0);
     
-    gAudioFramesPerAnalogFrame = context->audioFrames / context->analogFrames;
+    gAudioFramesPerAnalogFrame = context->analogFrames ? context->audioFrames / context->analogFrames : 0;
     printf("AnalogDensity: %u\n", gAudioFramesPerAnalogFrame);
+    gHitDetector.setup(context->analogSampleRate);
 
 	/*********/
 
@@ -294,11 +898,19 @@ bool setup(BelaContext *context, void *userData)	{
 	gChannelsInUse = gFirstScopeChannel + gScopeChannelsInUse;
 
 	// Create hashes for digital channels
-	generateDigitalNames(gDigitalChannelsInUse, gDigitalChannelOffset, gHvDigitalInHashes);
+	generateDigitalHashes(gDigitalChannelsInUse, gDigitalChannelOffset, gHvDigitalInHashes, gHvDigitalOutHashes);
+	hashReceivers();
 
 	/* HEAVY */
 
-	gHeavyContext = hv_bela_new_with_options(context->audioSampleRate, 1000, 200, 0);
+	HeavyPools::Sizes heavySizes = { kHeavyPoolKb, kHeavyInQueueKb };
+	if(!gHeavySizing && gHeavySizesPath && access(gHeavySizesPath, R_OK) == 0
+			&& HeavyPools::load(gHeavySizesPath, heavySizes))
+		printf("Heavy sizes from %s: pool %d kB, input queue %d kB\n", gHeavySizesPath, heavySizes.poolKb,
+				heavySizes.inQueueKb);
+	gHeavyContext = hv_bela_new_with_options(context->audioSampleRate, heavySizes.poolKb, heavySizes.inQueueKb, 0);
+	gHeavyPools.setup(gHeavyContext);
+	gHeavyPoolsTask = Bela_createAuxiliaryTask(warnHeavyPools, 10, "heavy-pools");
 
 	gHvInputChannels = hv_getNumInputChannels(gHeavyContext);
 	gHvOutputChannels = hv_getNumOutputChannels(gHeavyContext);
@@ -326,14 +938,38 @@ bool setup(BelaContext *context, void *userData)	{
 	printf("Scope out: %u\n", gScopeChannelsInUse);
 #endif // BELA_HV_SCOPE
 
+	gChannelRouting.setup(context, gHvInputChannels, gHvOutputChannels, gAudioChannelsInUse, gAnalogChannelsInUse);
+
+	size_t arenaBytes = MemoryArena::footprint(context->audioFrames * sizeof(float))
+		+ MemoryArena::footprint(hv_msg_getByteSize(2)) + 2 * MemoryArena::footprint(hv_msg_getByteSize(1))
+		+ MemoryArena::footprint(gHvInputChannels * context->audioFrames * sizeof(float))
+		+ MemoryArena::footprint(gHvOutputChannels * context->audioFrames * sizeof(float));
+#ifdef BELA_HV_SCOPE
+	if(gScopeChannelsInUse > 0)
+		arenaBytes += MemoryArena::footprint(sizeof(Scope))
+				+ MemoryArena::footprint(kScopeBatchFrames * gScopeChannelsInUse * sizeof(float));
+#endif // BELA_HV_SCOPE
+	if(!gArena.setup(arenaBytes))
+		return false;
+
+	gTremoloGain = gArena.allocate<float>(context->audioFrames, "tremolo gain");
+	gKeyMessage = (HvMessage*) gArena.allocate(hv_msg_getByteSize(2), "key message");
+	hv_msg_init(gKeyMessage, 2, 0);
+	gFloatMessage = (HvMessage*) gArena.allocate(hv_msg_getByteSize(1), "float message");
+	hv_msg_init(gFloatMessage, 1, 0);
+	gBangMessage = (HvMessage*) gArena.allocate(hv_msg_getByteSize(1), "bang message");
+	hv_msg_init(gBangMessage, 1, 0);
+	hv_msg_setBang(gBangMessage, 0);
+	gMultiplexerMessage = (HvMessage*) gArena.allocate(hv_msg_getByteSize(2), "multiplexer message");
+	hv_msg_init(gMultiplexerMessage, 2, 0);
 	if(gHvInputChannels != 0) {
-		gHvInputBuffers = (float *)calloc(gHvInputChannels * context->audioFrames,sizeof(float));
+		gHvInputBuffers = gArena.allocate<float>(gHvInputChannels * context->audioFrames, "heavy inputs");
 	}
 	if(gHvOutputChannels != 0) {
-		gHvOutputBuffers = (float *)calloc(gHvOutputChannels * context->audioFrames,sizeof(float));
+		gHvOutputBuffers = gArena.allocate<float>(gHvOutputChannels * context->audioFrames, "heavy outputs");
 	}
 
-	gInverseSampleRate = 1.0 / context->audioSampleRate;
+	gMsPerFrame = 1000.0 / context->audioSampleRate;
 
 	// Set heavy print hook
 	hv_setPrintHook(gHeavyContext, printHook);
@@ -346,18 +982,26 @@ bool setup(BelaContext *context, void *userData)	{
 		exit(1);
 #endif
 #ifdef BELA_HV_SCOPE
-		scope = new Scope();
-		scope->setup(gScopeChannelsInUse, context->audioSampleRate);
-		gScopeOut = new float[gScopeChannelsInUse];
+		gScopeDecimation = std::max(1u, gScopeDecimation);
+		const float scopeRate = context->audioSampleRate / gScopeDecimation;
+		scope = new(gArena.allocate(sizeof(Scope), "scope")) Scope();
+		scope->setup(gScopeChannelsInUse, scopeRate);
+		gScopeBatch = gArena.allocate<float>(kScopeBatchFrames * gScopeChannelsInUse, "scope batch");
+		ScopeCapture::Mode mode = gScopeTrigger == kScopeFreeRun ? ScopeCapture::kFreeRun
+				: gScopeTrigger == kScopeOnLevel ? ScopeCapture::kOnLevel : ScopeCapture::kOnTrigger;
+		gScopeCapture.setup(gScopeChannelsInUse, gScopeDecimation, mode, gScopePreMs * scopeRate / 1000,
+				gScopePostMs * scopeRate / 1000, gScopeTriggerChannel, gScopeTriggerLevel);
+		gScopeTask = Bela_createAuxiliaryTask(logScope, 15, "scope-log");
 #endif // BELA_HV_SCOPE
 	}
 	// Bela digital
 	if(gDigitalEnabled)
 	{
 		dcm.setCallback(sendDigitalMessage);
+		updateDigitalSigOutMask();
 		if(gDigitalChannelsInUse> 0){
 			for(unsigned int ch = 0; ch < gDigitalChannelsInUse; ++ch){
-				dcm.setCallbackArgument(ch, (void *) gHvDigitalInHashes[ch].c_str());
+				dcm.setCallbackArgument(ch, (void *) &gHvDigitalInHashes[ch]);
 			}
 		}
 	}
@@ -366,55 +1010,100 @@ bool setup(BelaContext *context, void *userData)	{
 	// when you want to send a message from Heavy to the wrapper.
 	multiplexerTableHash = hv_stringToHash(multiplexerArray);
 	if(context->multiplexerChannels > 0){
-		pdMultiplexerActive = true;
 		multiplexerArraySize = context->multiplexerChannels * context->analogInChannels;
-		hv_table_setLength(gHeavyContext, multiplexerTableHash, multiplexerArraySize);
-		hv_sendFloatToReceiver(gHeavyContext, hv_stringToHash("bela_multiplexerChannels"), context->multiplexerChannels);
+		// only a patch with a [table bela_multiplexer] has anywhere to put them
+		pdMultiplexerActive = hv_table_setLength(gHeavyContext, multiplexerTableHash, multiplexerArraySize);
+		gMultiplexer.setup(context->multiplexerChannels, context->analogInChannels, context->analogSampleRate,
+				gMultiplexerSmoothingMs, gMultiplexerThreshold);
+		hv_sendFloatToReceiver(gHeavyContext, gReceivers[kReceiverMultiplexerChannels].hash, context->multiplexerChannels);
+	}
+	// a bad tables.bin is reported and the exported tables are kept
+	if(access(gTableBlobPath, F_OK) == 0 && gTableBlob.open(gTableBlobPath)) {
+		unsigned int numTables = gTableBlob.bind(gHeavyContext);
+		printf("Loaded %u of %u tables from %s\n", numTables, gTableBlob.getNumTables(), gTableBlobPath);
 	}
+	tableBlobChanged();
+	gTableBank.setup(gHeavyContext);
+	gControlQueue.setup(kControlQueueSize);
+	gVoices.setup(kNumVoices, kVoiceTailMs / gMsPerFrame);
+#ifdef BELA_HV_IDLE_BYPASS
+	gIdleHoldFrames = kIdleHoldMs / gMsPerFrame;
+	gHeavyPending = true; // the patch's loadbangs
+#endif // BELA_HV_IDLE_BYPASS
+	if(gEventReplayPath && gEventReplayer.load(gEventReplayPath, context->audioSampleRate))
+		printf("Replaying %zu events from %s\n", gEventReplayer.getNumEvents(), gEventReplayPath);
+	if(gEventRecordPath && gEventRecorder.open(gEventRecordPath, context->audioSampleRate)) {
+		printf("Recording events to %s\n", gEventRecordPath);
+		gEventFlushTask = Bela_createAuxiliaryTask(flushEvents, 20, "event-flush");
+		gEventFlushBlocks = std::max(1u, (unsigned int)(kEventFlushMs / (gMsPerFrame * context->audioFrames)));
+	}
+#ifdef BELA_HV_PROFILE
+	gProfiler.setup(gProfileStageNames, kNumProfileStages, context->audioFrames * 1e9 / context->audioSampleRate,
+			kProfileWindowMs / (gMsPerFrame * context->audioFrames));
+	gProfileTask = Bela_createAuxiliaryTask(printProfile, 10, "profile-print");
+#endif // BELA_HV_PROFILE
+#ifdef BELA_HV_WATCHDOG
+	gWatchdog.setup(kNumQualityLevels, context->audioFrames * 1e9 / context->audioSampleRate,
+			kWatchdogDegradeMs / (gMsPerFrame * context->audioFrames),
+			kWatchdogRecoverMs / (gMsPerFrame * context->audioFrames),
+			kWatchdogWarmupMs / (gMsPerFrame * context->audioFrames));
+#endif // BELA_HV_WATCHDOG
+	gTableWatchTask = Bela_createAuxiliaryTask(watchTableBlob, 50, "table-watch");
+	gTableWatchBlocks = std::max(1u, (unsigned int)(kTableWatchMs / (gMsPerFrame * context->audioFrames)));
+	MemoryArena::lockProcess();
+	gArena.printFootprint(hv_getSize(gHeavyContext));
 //    hv_sendMessageToReceiverV(gHeavyContext, hv_stringToHash("sendfromhvcc"), 0.0f, "s", "success");
 	return true;
 }
 
 void render(BelaContext *context, void *userData)
 {
-	// De-interleave the data
-	if(gHvInputBuffers != NULL) {
-		for(unsigned int n = 0; n < context->audioFrames; n++) {
-			for(unsigned int ch = 0; ch < gHvInputChannels; ch++) {
-				if(ch >= gAudioChannelsInUse + gAnalogChannelsInUse) {
-					// THESE ARE PARAMETER INPUT 'CHANNELS' USED FOR ROUTING
-					// 'sensor' outputs from routing channels of dac~ are passed through here
-					// these could be also digital channels (handled by the dcm)
-					// or parameter channels used for routing (currently unhandled)
-					break;
-				} else {
-					// If more than 2 ADC inputs are used in the pd patch, route the analog inputs
-					// i.e. ADC3->analogIn0 etc. (first two are always audio inputs)
-					if(ch >= gAudioChannelsInUse)
-					{
-						unsigned int analogCh = ch - gAudioChannelsInUse;
-						if(analogCh < context->analogInChannels)
-						{
-							int m = n/2;
-							float mIn = analogRead(context, m, analogCh);
-							gHvInputBuffers[ch * context->audioFrames + n] = mIn;
-						}
-					} else {
-						if(ch < context->audioInChannels)
-							gHvInputBuffers[ch * context->audioFrames + n] = audioRead(context, n, ch);
-					}
-				}
-			}
-		}
+	PROFILE_BEGIN();
+#ifdef BELA_HV_WATCHDOG
+	gWatchdog.beginBlock();
+#endif // BELA_HV_WATCHDOG
+	const unsigned int quality = qualityLevel();
+	gBlockStartFrame = context->audioFramesElapsed;
+	static unsigned int tableWatchCount = 0;
+	if(++tableWatchCount >= gTableWatchBlocks) {
+		tableWatchCount = 0;
+		Bela_scheduleAuxiliaryTask(gTableWatchTask);
+	}
+	static unsigned int eventFlushCount = 0;
+	if(gEventRecorder.isOpen() && (++eventFlushCount >= gEventFlushBlocks || gEventRecorder.wantsFlush())) {
+		eventFlushCount = 0;
+		Bela_scheduleAuxiliaryTask(gEventFlushTask);
 	}
+	gTableBank.apply();
+	const unsigned int controlMessages = quality >= kQualityLight ? kControlMessagesUnderLoad : kControlMessagesPerBlock;
+#ifdef BELA_HV_IDLE_BYPASS
+	if(gControlQueue.drain(gHeavyContext, controlMessages))
+		gHeavyPending = true;
+#else
+	gControlQueue.drain(gHeavyContext, controlMessages);
+#endif // BELA_HV_IDLE_BYPASS
+	PROFILE_STAGE(kStageControl);
+
+	// De-interleave the data
+	if(gHvInputBuffers != NULL)
+		gChannelRouting.deinterleave(context, gHvInputBuffers);
+	PROFILE_STAGE(kStageDeinterleave);
 
 	if(pdMultiplexerActive){
-		static int lastMuxerUpdate = 0;
-		if(++lastMuxerUpdate == multiplexerArraySize){
-			lastMuxerUpdate = 0;
-			memcpy(hv_table_getBuffer(gHeavyContext, multiplexerTableHash), (float *const)context->multiplexerAnalogIn, multiplexerArraySize * sizeof(float));
+		const unsigned int numChanges = gMultiplexer.process(context->multiplexerAnalogIn,
+				context->multiplexerStartingChannel, context->analogFrames,
+				hv_table_getBuffer(gHeavyContext, multiplexerTableHash));
+		if(gMultiplexerNotify && numChanges) {
+			for(unsigned int n = 0; n < numChanges; ++n) {
+				const MultiplexerInput::Change& change = gMultiplexer.getChange(n);
+				sendMultiplexerChange(change, change.frame * gAudioFramesPerAnalogFrame);
+			}
+#ifdef BELA_HV_IDLE_BYPASS
+			gHeavyPending = true;
+#endif // BELA_HV_IDLE_BYPASS
 		}
 	}
+	PROFILE_STAGE(kStageMultiplexer);
 
 
 	// Bela digital in
@@ -424,12 +1113,41 @@ void render(BelaContext *context, void *userData)
 		// Bela digital in at message-rate
 		dcm.processInput(context->digital, context->digitalFrames);
 	}
+	PROFILE_STAGE(kStageDigitalIn);
 
 	// replacement for bang~ object
 	//hv_sendMessageToReceiverV(gHeavyContext, "bela_bang", 0.0f, "b");
 
 	// heavy audio callback
+	if(gHeavyPools.sample())
+		Bela_scheduleAuxiliaryTask(gHeavyPoolsTask);
+#ifdef BELA_HV_IDLE_BYPASS
+	/*
+	 *  MODIFICATION
+	 *  ------------
+	 *  Skip Heavy while it has nothing to play, see gVoices
+	 */
+	const uint64_t blockEndFrame = gBlockStartFrame + context->audioFrames;
+	if(peakLevel(gHvInputBuffers, gHvInputChannels * context->audioFrames) >= kIdleLevel)
+		gLastSoundFrame = blockEndFrame;
+	bool idle = !gHeavyPending && gVoices.isAsleep(gBlockStartFrame)
+			&& gBlockStartFrame >= gLastSoundFrame + gIdleHoldFrames;
+	if(idle) {
+		if(!gHeavyIdle && gHvOutputBuffers != NULL)
+			memset(gHvOutputBuffers, 0, gHvOutputChannels * context->audioFrames * sizeof(float));
+		++gIdleBlocks;
+	} else {
+		hv_processInline(gHeavyContext, gHvInputBuffers, gHvOutputBuffers, context->audioFrames);
+		if(peakLevel(gHvOutputBuffers, gHvOutputChannels * context->audioFrames) >= kIdleLevel)
+			gLastSoundFrame = blockEndFrame;
+	}
+	gHeavyIdle = idle;
+	gHeavyPending = false;
+	/*********/
+#else
 	hv_processInline(gHeavyContext, gHvInputBuffers, gHvOutputBuffers, context->audioFrames);
+#endif // BELA_HV_IDLE_BYPASS
+	PROFILE_STAGE(kStageHeavy);
 	/*
 	for(int n = 0; n < context->audioFrames*gHvOutputChannels; ++n)
 	{
@@ -442,48 +1160,34 @@ void render(BelaContext *context, void *userData)
 	// Bela digital out
 	if(gDigitalEnabled)
 	{
-		// Bela digital out at signal-rate
-		if(gDigitalSigOutChannelsInUse > 0)
+		// Bela digital out at signal-rate, one digital frame per audio frame
+		if(gDigitalSigOutMask)
 		{
-				unsigned int j, k;
-				float *p0, *p1;
-				const unsigned int gLibpdBlockSize = context->audioFrames;
-				const unsigned int audioFrameBase = 0;
-				float* gOutBuf = gHvOutputBuffers;
-				// block below copy/pasted from libpd, except
-				// context->digitalChannels has been replaced with gDigitalSigOutChannelsInUse
-				for (j = 0, p0 = gOutBuf; j < gLibpdBlockSize; ++j, ++p0) {
-					unsigned int digitalFrame = (audioFrameBase + j);
-					for (k = 0, p1 = p0 + gLibpdBlockSize * gFirstDigitalChannel;
-							k < gDigitalSigOutChannelsInUse; k++, p1 += gLibpdBlockSize) {
-						if(dcm.isSignalRate(k) && dcm.isOutput(k)){ // only process output channels that are handled at signal rate
-							digitalWriteOnce(context, digitalFrame, k, *p1 > 0.5);
-						}
-					}
-				}
+			const unsigned int numFrames = std::min(context->audioFrames, context->digitalFrames);
+			const uint32_t outputBits = gDigitalSigOutMask << kDigitalValueShift;
+			uint32_t* digital = context->digital;
+			for(unsigned int n = 0; n < numFrames; ++n)
+				digital[n] &= ~outputBits;
+			for(uint32_t channels = gDigitalSigOutMask; channels; channels &= channels - 1) {
+				const unsigned int k = __builtin_ctz(channels);
+				const float* out = gHvOutputBuffers + (gFirstDigitalChannel + k) * context->audioFrames;
+				for(unsigned int n = 0; n < numFrames; ++n)
+					digital[n] |= (uint32_t)(out[n] > 0.5f) << (kDigitalValueShift + k);
+			}
 		}
 		// Bela digital out at message-rate
 		dcm.processOutput(context->digital, context->digitalFrames);
 	}
+	PROFILE_STAGE(kStageDigitalOut);
 
 #ifdef BELA_HV_SCOPE
 	// Bela scope
-	if(gScopeChannelsInUse > 0)
-	{
-		unsigned int j, k;
-		float *p0, *p1;
-		const unsigned int gLibpdBlockSize = context->audioFrames;
-		float* gOutBuf = gHvOutputBuffers;
-
-		// block below copy/pasted from libpd
-		for (j = 0, p0 = gOutBuf; j < gLibpdBlockSize; ++j, ++p0) {
-			for (k = 0, p1 = p0 + gLibpdBlockSize * gFirstScopeChannel; k < gScopeChannelsInUse; k++, p1 += gLibpdBlockSize) {
-				gScopeOut[k] = *p1;
-			}
-			scope->log(gScopeOut);
-		}
-	}
+	if(gScopeChannelsInUse > 0 && quality < kQualityLight
+			&& gScopeCapture.write(gHvOutputBuffers + gFirstScopeChannel * context->audioFrames, context->audioFrames,
+					context->audioFrames))
+		Bela_scheduleAuxiliaryTask(gScopeTask);
 #endif // BELA_HV_SCOPE
+	PROFILE_STAGE(kStageScope);
 
 	// Interleave the output data
 	if(gHvOutputBuffers != NULL) {
@@ -494,106 +1198,32 @@ void render(BelaContext *context, void *userData)
 		 */
 
 		// Generate a sinewave with frequency set by gTremoloRate
-		// and amplitude from -0.5 to 0.5
-		float lfo = sinf(gPhase) * 0.5;
-		// Keep track and wrap the phase of the sinewave
-		gPhase += 2.0 * M_PI * gTremoloRate * gInverseSampleRate;
-		if(gPhase > 2.0 * M_PI)
-			gPhase -= 2.0 * M_PI;
+		// and amplitude from -0.5 to 0.5, one value per sample
+		gTremolo.process(gTremoloGain, context->audioFrames);
+		PROFILE_STAGE(kStageTremolo);
         
         
-        for(unsigned int n = 0; n < 8; n++) {
-            for(unsigned int m = 0; m < 6; m++){
-                if(m == 5 && n > 3) {
-                    gSensorIn[m][n] = 0;
-                } else {
-                    gSensorIn[m][n] = !digitalRead(context, n, m + 3);
-                }
-                if(gSensorIn[m][n]) {
-                    gSensorDeb[m][n] = 256;
-                }
-                if(gSensorIn[m][n] != gSensorOut[m][n]) {
-                    if(gSensorIn[m][n]) {
-                        gSensorOut[m][n] = 1;
-                        hv_sendMessageToReceiverV(gHeavyContext, hv_stringToHash("keystatus"), 0.0f, "ff", (float) m * 8 + n, 1.0f);
-                    } else {
-                        if(gSensorDeb[m][n] == 0) {
-                            gSensorOut[m][n] = 0;
-                            hv_sendMessageToReceiverV(gHeavyContext, hv_stringToHash("keystatus"), 0.0f, "ff", (float) m * 8 + n, 0.0f);
-                        } else {
-                            gSensorDeb[m][n]--;
-                        }
-                    }
-                }
-            }
-            if(gXSensorActive[n]) {
-                if(gXSensorInverted[n]){
-                    gXSensorIn[n] = digitalRead(context, n, 15);
-                } else {
-                    gXSensorIn[n] = !digitalRead(context, n, 15);
-                }
-            } else {
-                gXSensorIn[n] = false;
-            }
-            if(gXSensorIn[n] != gXSensorOut[n]) {
-                if(gXSensorIn[n]) {
-                    gXSensorOut[n] = 1;
-                    hv_sendMessageToReceiverV(gHeavyContext, hv_stringToHash("xkeystatus"), 0.0f, "ff", (float) n, 1.0f);
-                } else {
-                    if(gXSensorDeb[n] == 0) {
-                        gXSensorOut[n] = 0;
-                        hv_sendMessageToReceiverV(gHeavyContext, hv_stringToHash("xkeystatus"), 0.0f, "ff", (float) n, 0.0f);
-                    } else {
-                        gXSensorDeb[n]--;
-                    }
-                }
-            }
-        }
-        
-        for(unsigned int n = 0; n < context->audioFrames; n++) {
-            if(gAudioFramesPerAnalogFrame && !(n % gAudioFramesPerAnalogFrame)) {
-                float hitSensor = analogRead(context, n/gAudioFramesPerAnalogFrame, gHitSensorChannel);
-                if(hitSensor < 0.1) {
-                    if(gHitDeb == 0) {
-                        hv_sendBangToReceiver(gHeavyContext, hv_stringToHash("nedslag1"));
-                    }
-                    gHitDeb = 1024;
-                } else {
-                    if(hitSensor > 0.4 && gHitDeb > 0) {
-                        gHitDeb--;
-                    }
-                }
-                    
-            }
+        if(gEventReplayer.isLoaded()) {
+            replayEvents(context);
+            PROFILE_STAGE(kStageKeys);
+        } else {
+            scanKeys(context);
+            PROFILE_STAGE(kStageKeys);
+            scanHitSensor(context);
         }
+        PROFILE_STAGE(kStageHits);
 
 		/*********/
-		for(unsigned int n = 0; n < context->audioFrames; n++) {
-			for(unsigned int ch = 0; ch < gHvOutputChannels; ch++) {
-				if(ch >= gAudioChannelsInUse + gAnalogChannelsInUse) {
-					// THESE ARE SENSOR OUTPUT 'CHANNELS' USED FOR ROUTING
-					// they are the content of the 'sensor output' dac~ channels
-				} else {
-					if(ch >= gAudioChannelsInUse)	{
-						int m = n/2;
-						unsigned int analogCh = ch - gAudioChannelsInUse;
-						if(analogCh < context->analogOutChannels)
-							analogWriteOnce(context, m, analogCh, gHvOutputBuffers[ch*context->audioFrames + n]);
-					} else {
-						if(ch < context->audioOutChannels)
-							audioWrite(context, n, ch, gHvOutputBuffers[ch * context->audioFrames + n] * lfo); // MODIFICATION (* lfo)
-					}
-				}
-			}
-		}
+		gChannelRouting.interleave(context, gHvOutputBuffers, gTremoloGain); // MODIFICATION (* lfo)
         // Write the adresser to digital pins 0-2
-        for(unsigned int n = 0; n < context->digitalFrames; ++n){
-            digitalWrite(context, n, 0, (bool)(n & 4));
-            digitalWrite(context, n, 1, (bool)(n & 2));
-            digitalWrite(context, n, 2, (bool)(n & 1));
-        }
+        writeAddress(context);
+        PROFILE_STAGE(kStageInterleave);
         //
 	}
+	PROFILE_END();
+#ifdef BELA_HV_WATCHDOG
+	gWatchdog.endBlock();
+#endif // BELA_HV_WATCHDOG
     
 //    hv_sendMessageToReceiverV(gHeavyContext, hv_stringToHash("sendfromhvcc"), 0.0f, "s", "success");
 }
@@ -601,11 +1231,55 @@ void render(BelaContext *context, void *userData)
 
 void cleanup(BelaContext *context, void *userData)
 {
+	ControlQueue::Stats controlStats = gControlQueue.getStats();
+	if(controlStats.dropped || controlStats.rejected || controlStats.deferred)
+		printf("Control messages: %llu pushed, %llu dropped, %llu rejected by Heavy, %llu blocks over budget\n",
+				(unsigned long long)controlStats.pushed, (unsigned long long)controlStats.dropped,
+				(unsigned long long)controlStats.rejected, (unsigned long long)controlStats.deferred);
+#ifdef BELA_HV_IDLE_BYPASS
+	if(gIdleBlocks)
+		printf("Heavy skipped for %llu of %llu blocks\n", (unsigned long long)gIdleBlocks,
+				(unsigned long long)(context->audioFramesElapsed / context->audioFrames));
+#endif // BELA_HV_IDLE_BYPASS
+#ifdef BELA_HV_WATCHDOG
+	const DeadlineWatchdog::Stats& watchdogStats = gWatchdog.getStats();
+	if(watchdogStats.degrades || watchdogStats.overruns) {
+		printf("Watchdog: %llu overruns, %llu steps down, worst block %u ns\n",
+				(unsigned long long)watchdogStats.overruns, (unsigned long long)watchdogStats.degrades,
+				watchdogStats.worstNs);
+		for(unsigned int n = 0; n < kNumQualityLevels; ++n)
+			printf("  level %u: %llu blocks\n", n, (unsigned long long)watchdogStats.blocks[n]);
+	}
+#endif // BELA_HV_WATCHDOG
+#ifdef BELA_HV_SCOPE
+	if(gScopeCapture.getLostFrames() || gScopeCapture.getIgnoredTriggers())
+		printf("Scope: %llu frames lost, %llu triggers ignored\n", (unsigned long long)gScopeCapture.getLostFrames(),
+				(unsigned long long)gScopeCapture.getIgnoredTriggers());
+#endif // BELA_HV_SCOPE
+	if(gVoices.getSteals())
+		printf("Voices stolen: %llu\n", (unsigned long long)gVoices.getSteals());
+	if(gEventRecorder.isOpen()) {
+		printf("Recorded %llu events, %llu dropped\n", (unsigned long long)gEventRecorder.getRecorded(),
+				(unsigned long long)gEventRecorder.getDropped());
+		gEventRecorder.close(context->audioFramesElapsed);
+	}
+	printPoolUsage(stdout);
+	if(gHeavySizing && gHeavySizesPath) {
+		HeavyPools::Sizes sizes = gHeavyPools.recommend();
+		HeavyPools::Sizes previous = { HeavyPools::kMinPoolKb, HeavyPools::kMinInQueueKb };
+		if(access(gHeavySizesPath, R_OK) == 0)
+			HeavyPools::load(gHeavySizesPath, previous);
+		sizes.poolKb = std::max(sizes.poolKb, previous.poolKb);
+		sizes.inQueueKb = std::max(sizes.inQueueKb, previous.inQueueKb);
+		if(HeavyPools::save(gHeavySizesPath, sizes))
+			printf("Heavy sizes written to %s: pool %d kB, input queue %d kB\n", gHeavySizesPath, sizes.poolKb,
+					sizes.inQueueKb);
+	}
 	hv_delete(gHeavyContext);
-	free(gHvInputBuffers);
-	free(gHvOutputBuffers);
+	gTableBlob.close();
 #ifdef BELA_HV_SCOPE
-	delete[] gScopeOut;
-	delete scope;
+	if(scope)
+		scope->~Scope();
 #endif // BELA_HV_SCOPE
+	gArena.release();
 }